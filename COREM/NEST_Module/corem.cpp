@@ -1,6 +1,8 @@
 #include "corem.h"
 
 // C++ includes:
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <iomanip>
 #include <iostream>
@@ -23,6 +25,25 @@
 
 
 RetinaInterface mynest::corem::retina;
+pthread_mutex_t mynest::corem::retinaMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t mynest::corem::retinaCond = PTHREAD_COND_INITIALIZER;
+bool mynest::corem::retinaInitialized = false;
+long mynest::corem::retinaOrigin = -1;
+long mynest::corem::retinaSteps = 0;
+long mynest::corem::retinaTarget = 0;
+std::atomic< long > mynest::corem::retinaReadySlice( -1 );
+int mynest::corem::nestStepsPerRetinaStep = 1;
+int mynest::corem::retinaStepsPerNestStep = 1;
+std::vector< std::vector<double> > mynest::corem::stepValues;
+double mynest::corem::nestResolution = 1.0;
+SpikingOutput* mynest::corem::spikingModule = NULL;
+std::vector< std::vector<spike_t> > mynest::corem::stepSpikes;
+std::vector< long > mynest::corem::stepSpikesStep;
+bool mynest::corem::pipelined = false;
+bool mynest::corem::workerRunning = false;
+bool mynest::corem::stopWorker = false;
+pthread_t mynest::corem::workerThread;
+bool mynest::corem::exitHookRegistered = false;
 
 using namespace nest;
 
@@ -41,7 +62,8 @@ RecordablesMap< mynest::corem >::create()
 
 mynest::corem::Parameters_::Parameters_()
     : cell_number    (0.0),
-      retina_file ("empty")
+      retina_file ("empty"),
+      pipeline (false)
 {
 }
 
@@ -54,6 +76,7 @@ mynest::corem::Parameters_::get( DictionaryDatum& d ) const
 {
     def< double >( d, names::port, cell_number );
     def< std::string >( d, names::file, retina_file );
+    def< bool >( d, Name( "pipeline" ), pipeline );
 }
 
 void
@@ -61,6 +84,7 @@ mynest::corem::Parameters_::set( const DictionaryDatum& d )
 {
     updateValue< double >( d, names::port, cell_number );
     updateValue< std::string >( d, names::file, retina_file );
+    updateValue< bool >( d, Name( "pipeline" ), pipeline );
 
 }
 
@@ -106,6 +130,270 @@ mynest::corem::~corem()
 {
 }
 
+void
+mynest::corem::retinaLoad( const std::string& file, bool pipeline, bool force )
+{
+  pthread_mutex_lock( &retinaMutex );
+  // A forced reload is only done once per simulation: if the retina has not started since the
+  // last load (the first cell of corem and corem_spike nodes both force it), it is kept
+  if ( !retinaInitialized || ( force && retinaOrigin >= 0 ) )
+  {
+    // The worker thread of the previous retina is stopped before loading the new one
+    stopRetinaWorker();
+
+    retina.setVerbosity( false );
+    retina.allocateValues( file.c_str(), "_output_multimeter.txt", 1.0, 0 );
+
+    retinaInitialized = true;
+    retinaOrigin = -1;
+    retinaSteps = 0;
+    retinaTarget = 0;
+    retinaReadySlice.store( -1 );
+    stepValues.clear();
+    stepSpikes.clear();
+    stepSpikesStep.clear();
+    pipelined = pipeline;
+  }
+  pthread_mutex_unlock( &retinaMutex );
+}
+
+// Stop the worker thread (if it is running) and wait until it finishes the retina step it is
+// computing. Called with the mutex locked
+void
+mynest::corem::stopRetinaWorker()
+{
+  if ( workerRunning )
+  {
+    stopWorker = true;
+    pthread_cond_broadcast( &retinaCond );
+    pthread_mutex_unlock( &retinaMutex );
+    pthread_join( workerThread, NULL );
+    pthread_mutex_lock( &retinaMutex );
+    workerRunning = false;
+    stopWorker = false;
+  }
+}
+
+// Registered with atexit() when the first worker thread is created. The exit functions run
+// before the destruction of the static objects constructed before their registration, so the
+// worker does not update the retina while it is destroyed
+void
+mynest::corem::retinaExit()
+{
+  pthread_mutex_lock( &retinaMutex );
+  stopRetinaWorker();
+  pthread_mutex_unlock( &retinaMutex );
+}
+
+// Called with the mutex locked by the first node update. The retina time step must be a multiple
+// or a divisor of the NEST resolution. The ring holds the retina steps of two min-delay slices
+// (the current one and the one computed ahead by the worker thread)
+void
+mynest::corem::retinaStart( long step )
+{
+  double resolution = Time::get_resolution().get_ms();
+  double retina_step = retina.getSimStep();
+
+  nestResolution = resolution;
+  nestStepsPerRetinaStep = 1;
+  retinaStepsPerNestStep = 1;
+  if ( retina_step >= resolution )
+    nestStepsPerRetinaStep = ( int ) ( retina_step / resolution + 0.5 );
+  else
+    retinaStepsPerNestStep = ( int ) ( resolution / retina_step + 0.5 );
+
+  if ( std::abs( nestStepsPerRetinaStep * resolution
+         - retinaStepsPerNestStep * retina_step ) > 1e-6 * resolution )
+    std::cout << "COREM warning: the retina time step (" << retina_step
+              << " ms) is not a multiple or a divisor of the NEST resolution ("
+              << resolution << " ms)" << std::endl;
+
+  long min_delay = kernel().connection_manager.get_min_delay();
+  long slice_steps = min_delay * retinaStepsPerNestStep / nestStepsPerRetinaStep + 2;
+
+  retinaOrigin = step;
+  stepValues.resize( 2 * slice_steps );
+
+  // Spikes of the first SpikingOutput module, in a ring indexed by NEST step
+  spikingModule = NULL;
+  Retina& r = retina.getRetina();
+  for ( int k = 1; k < r.getNumberModules() && spikingModule == NULL; k++ )
+    spikingModule = dynamic_cast< SpikingOutput* >( r.getModule( k ) );
+  stepSpikes.assign( 2 * ( min_delay + nestStepsPerRetinaStep ) + 2, std::vector< spike_t >() );
+  stepSpikesStep.assign( stepSpikes.size(), -1 );
+
+  if ( pipelined )
+  {
+    stopWorker = false;
+    workerRunning = ( pthread_create( &workerThread, NULL, retinaWorker, NULL ) == 0 );
+    if ( !workerRunning )
+      std::cout << "COREM warning: the retina worker thread could not be created" << std::endl;
+    else if ( !exitHookRegistered )
+      exitHookRegistered = ( atexit( retinaExit ) == 0 );
+  }
+}
+
+// Index of the retina step whose output is used at a NEST step
+long
+mynest::corem::retinaStepOf( long step )
+{
+  return ( ( step - retinaOrigin ) / nestStepsPerRetinaStep + 1 ) * retinaStepsPerNestStep - 1;
+}
+
+// Compute the next retina step and keep its output if it is read by NEST
+void
+mynest::corem::computeRetinaStep( long index )
+{
+  retina.update();
+
+  if ( ( index + 1 ) % retinaStepsPerNestStep == 0 )
+  {
+    std::vector< double >& values = stepValues[ index % stepValues.size() ];
+    values.resize( retina.getNumberOutputCells() );
+    if ( !values.empty() )
+      retina.getValues( 0, values.size(), &values[ 0 ] );
+  }
+
+  if ( spikingModule != NULL )
+    storeRetinaSpikes( index );
+}
+
+static bool
+spike_neuron_comp( const spike_t& spk1, const spike_t& spk2 )
+{
+  return spk1.neuron < spk2.neuron;
+}
+
+// Distribute the spikes of a retina step into the NEST steps they belong to (spike times are
+// in seconds from the start of the retina). The spikes of each NEST step are sorted by neuron
+void
+mynest::corem::storeRetinaSpikes( long index )
+{
+  const std::vector< spike_t >& spikes = spikingModule->getSlotSpikes();
+  long first_step = retinaOrigin + ( index / retinaStepsPerNestStep ) * nestStepsPerRetinaStep;
+  long last_step = first_step + nestStepsPerRetinaStep - 1;
+
+  for ( size_t k = 0; k < spikes.size(); k++ )
+  {
+    long step = retinaOrigin + ( long ) std::floor( spikes[ k ].time * 1000.0 / nestResolution );
+    step = std::min( std::max( step, first_step ), last_step );
+
+    size_t slot = step % stepSpikes.size();
+    if ( stepSpikesStep[ slot ] != step )
+    {
+      stepSpikes[ slot ].clear();
+      stepSpikesStep[ slot ] = step;
+    }
+    stepSpikes[ slot ].push_back( spikes[ k ] );
+  }
+
+  for ( long step = first_step; step <= last_step; step++ )
+  {
+    size_t slot = step % stepSpikes.size();
+    if ( stepSpikesStep[ slot ] == step )
+      std::stable_sort( stepSpikes[ slot ].begin(), stepSpikes[ slot ].end(), spike_neuron_comp );
+  }
+}
+
+const std::vector< double >&
+mynest::corem::retinaValues( long step )
+{
+  return stepValues[ retinaStepOf( step ) % stepValues.size() ];
+}
+
+// Number of spikes of a SpikingOutput neuron at a NEST step (after retinaAdvance())
+int
+mynest::corem::retinaSpikes( long step, unsigned long neuron )
+{
+  int num_spikes = 0;
+
+  if ( !stepSpikes.empty() )
+  {
+    size_t slot = step % stepSpikes.size();
+    if ( stepSpikesStep[ slot ] == step )
+    {
+      spike_t key;
+      key.time = 0.0;
+      key.neuron = neuron;
+      std::pair< std::vector< spike_t >::const_iterator, std::vector< spike_t >::const_iterator >
+        range = std::equal_range( stepSpikes[ slot ].begin(), stepSpikes[ slot ].end(), key, spike_neuron_comp );
+      num_spikes = range.second - range.first;
+    }
+  }
+  return num_spikes;
+}
+
+// Worker thread: computes the retina steps requested by the nodes (up to retinaTarget)
+// without holding the mutex, so the retina runs while NEST updates the network
+void*
+mynest::corem::retinaWorker( void* )
+{
+  pthread_mutex_lock( &retinaMutex );
+  while ( !stopWorker )
+  {
+    if ( retinaSteps >= retinaTarget )
+    {
+      pthread_cond_wait( &retinaCond, &retinaMutex );
+      continue;
+    }
+
+    long index = retinaSteps;
+    pthread_mutex_unlock( &retinaMutex );
+    computeRetinaStep( index );
+    pthread_mutex_lock( &retinaMutex );
+
+    retinaSteps++;
+    pthread_cond_broadcast( &retinaCond );
+  }
+  pthread_mutex_unlock( &retinaMutex );
+  return NULL;
+}
+
+// Make sure the retina steps of the min-delay slice starting at a NEST step have been computed.
+// Without the pipeline, the first node of the slice computes them all in one batch while the other
+// nodes wait on the mutex. With the pipeline, the worker thread is asked to compute also the next
+// slice, which overlaps with the update of NEST. Threads are synchronized by NEST at the end of
+// each slice, so the slots of the current slice are not overwritten while they are being read.
+// Once the slice is ready, the other nodes only read the atomic counter and skip the mutex
+void
+mynest::corem::retinaAdvance( long slice_origin )
+{
+  if ( retinaReadySlice.load( std::memory_order_acquire ) == slice_origin )
+    return;
+
+  pthread_mutex_lock( &retinaMutex );
+
+  if ( retinaOrigin < 0 )
+    retinaStart( slice_origin );
+
+  long min_delay = kernel().connection_manager.get_min_delay();
+  long needed = retinaStepOf( slice_origin + min_delay - 1 ) + 1;
+
+  if ( workerRunning )
+  {
+    long ahead = retinaStepOf( slice_origin + 2 * min_delay - 1 ) + 1;
+    if ( ahead > retinaTarget )
+    {
+      retinaTarget = ahead;
+      pthread_cond_broadcast( &retinaCond );
+    }
+    while ( retinaSteps < needed )
+      pthread_cond_wait( &retinaCond, &retinaMutex );
+  }
+  else
+  {
+    while ( retinaSteps < needed )
+    {
+      computeRetinaStep( retinaSteps );
+      retinaSteps++;
+    }
+  }
+
+  // Published after the steps (and the worker request) of the slice, under the mutex
+  retinaReadySlice.store( slice_origin, std::memory_order_release );
+  pthread_mutex_unlock( &retinaMutex );
+}
+
 void
 mynest::corem::init_state_( const Node& proto )
 {
@@ -118,9 +406,9 @@ mynest::corem::init_buffers_()
 {
   B_.logger_.reset();
 
-    if(this->P_.cell_number==0.0){
-          retinaInit();
-    }
+  // The node of the first cell loads the retina again (as in a new simulation),
+  // the other nodes only load it if it has not been loaded yet
+  retinaLoad( this->P_.retina_file, this->P_.pipeline, this->P_.cell_number == 0.0 );
 }
 
 void
@@ -138,14 +426,18 @@ mynest::corem::update( nest::Time const& origin,
     to >= 0 && ( delay ) from < kernel().connection_manager.get_min_delay() );
   assert( from < to );
 
+  const long cell = ( long ) this->P_.cell_number;
+
+  retinaAdvance( origin.get_steps() );
+
   for ( long lag = from; lag < to; ++lag )
   {
-    if(this->P_.cell_number==0.0){
-        retinaUpdate();
-    }
+    const std::vector< double >& values = retinaValues( origin.get_steps() + lag );
 
     CurrentEvent ce;
-    ce.set_current( (double_t)retinaGetValue() );
+    ce.set_current( ( cell >= 0 && ( size_t ) cell < values.size() )
+        ? ( double_t ) values[ cell ]
+        : -1.0 );
     kernel().event_delivery_manager.send( *this, ce, lag );
 
     B_.logger_.record_data( origin.get_steps() + lag );
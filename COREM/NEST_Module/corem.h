@@ -3,6 +3,20 @@
     within NEST, simulation is driven by the latter one, which periodically sends
     update requests and receives data of the analog  presynaptic current of
     ganglion cells.
+
+    All corem nodes share one retina, which may be read from any number of NEST
+    threads. The retina is advanced in batches of one min-delay slice by the first
+    node updated in the slice (under a mutex) and the output values of each step
+    are published in a ring of snapshots, which the nodes of all threads read
+    concurrently. The retina time step may be a multiple or a divisor of the NEST
+    resolution.
+
+    Parameters:
+    port -> cell number (index of the pixel in the layers of the Output module).
+    file -> retina script.
+    pipeline -> if true, a worker thread computes the retina one slice ahead,
+    concurrently with the update of the NEST network (taken from the node that
+    loads the retina, i.e., the node of cell 0).
  * ---------------------------------------------------------------- */
 
 #ifndef corem_H
@@ -21,8 +35,15 @@
 #include "ring_buffer.h"
 #include "universal_data_logger.h"
 
+// C++ includes:
+#include <atomic>
+#include <cstdlib>
+#include <pthread.h>
+#include <vector>
+
 // Corem interface
 #include "../src/RetinaInterface.h"
+#include "../src/SpikingOutput.h"
 
 // Includes from sli:
 #include "dictdatum.h"
@@ -34,20 +55,17 @@ class corem : public nest::Archiving_Node
 {
 public:
 
-    void retinaInit()
-    {
-        retina.setVerbosity(false);
-        const char * retinaPath = (this->P_.retina_file).c_str();
-        retina.allocateValues(retinaPath, "_output_multimeter.txt", 1.0, 0);
-    }
+    // Shared retina (also used by corem_spike nodes)
+    // Load the retina script (only the first time unless force is true and the loaded retina
+    // has already been simulated)
+    static void retinaLoad(const std::string& file, bool pipeline, bool force);
 
-    void retinaUpdate(){
-        retina.update();
-    }
+    // Compute the retina steps of the min-delay slice that starts at a NEST step
+    static void retinaAdvance(long slice_origin);
 
-    double retinaGetValue(){
-        return retina.getValue(this->P_.cell_number);
-    }
+    // Output values and number of spikes of a SpikingOutput neuron at a NEST step of the current slice
+    static const std::vector<double>& retinaValues(long step);
+    static int retinaSpikes(long step, unsigned long neuron);
 
   corem();
   corem( const corem& );
@@ -71,7 +89,39 @@ public:
   void set_status( const DictionaryDatum& );
 
 private:
+  // Retina shared by all nodes and threads, protected by retinaMutex
   static RetinaInterface retina;
+  static pthread_mutex_t retinaMutex;
+  static pthread_cond_t retinaCond;
+  static bool retinaInitialized;
+  // NEST step of the first retina step (-1 if not started), number of retina steps computed
+  // and requested to the worker thread
+  static long retinaOrigin, retinaSteps, retinaTarget;
+  // NEST slice whose retina steps have been computed (-1 if none). Read without the mutex by
+  // retinaAdvance(), so only the first node of each slice takes the mutex
+  static std::atomic< long > retinaReadySlice;
+  // Ratio between the retina time step and the NEST resolution
+  static int nestStepsPerRetinaStep, retinaStepsPerNestStep;
+  // Output values of the last retina steps (ring of two min-delay slices)
+  static std::vector< std::vector<double> > stepValues;
+  // Spikes of the first SpikingOutput module (if any) of the last NEST steps, sorted by neuron
+  static double nestResolution;
+  static SpikingOutput* spikingModule;
+  static std::vector< std::vector<spike_t> > stepSpikes;
+  static std::vector< long > stepSpikesStep; // NEST step stored in each slot
+  // Worker thread that computes the retina one slice ahead (pipeline parameter)
+  static bool pipelined, workerRunning, stopWorker;
+  static pthread_t workerThread;
+  // The worker thread is stopped at exit (before the static retina is destroyed)
+  static bool exitHookRegistered;
+  static void stopRetinaWorker();
+  static void retinaExit();
+
+  static void retinaStart(long step);
+  static long retinaStepOf(long step);
+  static void computeRetinaStep(long index);
+  static void storeRetinaSpikes(long index);
+  static void* retinaWorker(void*);
 
   void init_state_( const Node& proto );
   void init_buffers_();
@@ -86,6 +136,7 @@ private:
   {
       double cell_number;
       std::string retina_file;
+      bool pipeline;
 
       Parameters_();
 
@@ -27,6 +27,7 @@
 
 // include headers with your own stuff
 #include "corem.h"
+#include "corem_spike.h"
 
 // Includes from nestkernel:
 #include "connection_manager_impl.h"
@@ -91,5 +92,7 @@ mynest::corem_module::init( SLIInterpreter* i )
   */
   nest::kernel().model_manager.register_node_model< corem >(
     "corem" );
+  nest::kernel().model_manager.register_node_model< corem_spike >(
+    "corem_spike" );
 
 } // corem_module::init()
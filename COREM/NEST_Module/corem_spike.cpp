@@ -0,0 +1,100 @@
+#include "corem_spike.h"
+
+// Includes from nestkernel:
+#include "exceptions.h"
+#include "kernel_manager.h"
+
+// Includes from sli:
+#include "dict.h"
+#include "dictutils.h"
+#include "doubledatum.h"
+#include "integerdatum.h"
+
+using namespace nest;
+
+mynest::corem_spike::Parameters_::Parameters_()
+    : cell_number    (0.0),
+      retina_file ("empty"),
+      pipeline (false)
+{
+}
+
+void
+mynest::corem_spike::Parameters_::get( DictionaryDatum& d ) const
+{
+    def< double >( d, names::port, cell_number );
+    def< std::string >( d, names::file, retina_file );
+    def< bool >( d, Name( "pipeline" ), pipeline );
+}
+
+void
+mynest::corem_spike::Parameters_::set( const DictionaryDatum& d )
+{
+    updateValue< double >( d, names::port, cell_number );
+    updateValue< std::string >( d, names::file, retina_file );
+    updateValue< bool >( d, Name( "pipeline" ), pipeline );
+}
+
+mynest::corem_spike::corem_spike()
+  : Archiving_Node()
+  , P_()
+{
+}
+
+mynest::corem_spike::corem_spike( const corem_spike& n )
+  : Archiving_Node( n )
+  , P_( n.P_ )
+{
+}
+
+mynest::corem_spike::~corem_spike()
+{
+}
+
+void
+mynest::corem_spike::init_state_( const Node& proto )
+{
+}
+
+void
+mynest::corem_spike::init_buffers_()
+{
+  Archiving_Node::clear_history();
+
+  // As in corem nodes, the node of the first cell loads the retina again (only once per
+  // simulation if there is also a corem node of the first cell)
+  corem::retinaLoad( this->P_.retina_file, this->P_.pipeline, this->P_.cell_number == 0.0 );
+}
+
+void
+mynest::corem_spike::calibrate()
+{
+}
+
+void
+mynest::corem_spike::update( nest::Time const& origin,
+                                const long from,
+                                const long to )
+{
+  assert(
+    to >= 0 && ( delay ) from < kernel().connection_manager.get_min_delay() );
+  assert( from < to );
+
+  const unsigned long neuron = ( unsigned long ) this->P_.cell_number;
+
+  corem::retinaAdvance( origin.get_steps() );
+
+  for ( long lag = from; lag < to; ++lag )
+  {
+    int num_spikes = corem::retinaSpikes( origin.get_steps() + lag, neuron );
+
+    if ( num_spikes > 0 )
+    {
+      set_spiketime( Time::step( origin.get_steps() + lag + 1 ) );
+
+      SpikeEvent se;
+      se.set_multiplicity( num_spikes );
+      kernel().event_delivery_manager.send( *this, se, lag );
+    }
+  }
+}
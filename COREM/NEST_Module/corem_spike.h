@@ -0,0 +1,104 @@
+/* ----------------------------------------------------------------
+    Spike source node of COREM in NEST. Each corem_spike node is one output
+    neuron of the (first) SpikingOutput module of the retina and sends the spikes
+    generated by COREM as NEST spike events, so that spike-based ganglion output
+    can drive a NEST network without current-to-spike converter neurons.
+
+    The retina is shared with the corem nodes (see corem.h): it is advanced in
+    batches of one min-delay slice and the spikes of each NEST step are stored
+    sorted by neuron, so each node finds its spikes with a binary search. Several
+    spikes of a neuron in the same NEST step are sent as one event with multiplicity.
+
+    Parameters:
+    port -> output neuron index (the neuron index of the SpikingOutput spike file).
+    file -> retina script.
+    pipeline -> see corem.h.
+ * ---------------------------------------------------------------- */
+
+#ifndef corem_spike_H
+#define corem_spike_H
+
+// Includes from nestkernel:
+#include "archiving_node.h"
+#include "connection.h"
+#include "event.h"
+#include "nest_types.h"
+
+// Corem interface
+#include "corem.h"
+
+// Includes from sli:
+#include "dictdatum.h"
+
+namespace mynest
+{
+
+class corem_spike : public nest::Archiving_Node
+{
+public:
+  corem_spike();
+  corem_spike( const corem_spike& );
+  ~corem_spike();
+
+  using nest::Node::handle;
+  using nest::Node::handles_test_event;
+
+  nest::port send_test_event( nest::Node&, nest::port, nest::synindex, bool );
+
+  void get_status( DictionaryDatum& ) const;
+  void set_status( const DictionaryDatum& );
+
+private:
+  void init_state_( const Node& proto );
+  void init_buffers_();
+  void calibrate();
+
+  void update( nest::Time const&, const long, const long );
+
+  struct Parameters_
+  {
+      double cell_number;
+      std::string retina_file;
+      bool pipeline;
+
+      Parameters_();
+
+      void get( DictionaryDatum& ) const;
+      void set( const DictionaryDatum& );
+  };
+
+  Parameters_ P_;
+};
+
+inline nest::port
+mynest::corem_spike::send_test_event( nest::Node& target,
+  nest::port receptor_type,
+  nest::synindex,
+  bool )
+{
+  nest::SpikeEvent e;
+  e.set_sender( *this );
+  return target.handles_test_event( e, receptor_type );
+}
+
+inline void
+corem_spike::get_status( DictionaryDatum& d ) const
+{
+  P_.get( d );
+  Archiving_Node::get_status( d );
+}
+
+inline void
+corem_spike::set_status( const DictionaryDatum& d )
+{
+  Parameters_ ptmp = P_;
+  ptmp.set( d );
+
+  Archiving_Node::set_status( d );
+
+  P_ = ptmp;
+}
+
+}
+
+#endif
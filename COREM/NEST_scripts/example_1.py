@@ -14,8 +14,8 @@ simTime = 1200.0
 nest.ResetKernel()
 nest.ResetNetwork()
 
-# Number of threads (must be 1) and resolution (the same of the retina script)
-nest.SetKernelStatus({"local_num_threads": 1,'resolution': 1.0})
+# Number of threads (COREM nodes can be distributed across all threads) and resolution (the same of the retina script)
+nest.SetKernelStatus({"local_num_threads": 4,'resolution': 1.0})
 
 # Install module just once
 model = nest.Models(mtype='nodes',sel='corem')
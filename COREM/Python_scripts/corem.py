@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Python bindings of COREM. They use the C interface of the COREM library
+# (src/corem_api.h) through ctypes, so the retina runs inside the Python process:
+# a model is loaded from a script file or from the text of a script, NumPy frames
+# are fed to the buffer input of the script, the simulation is advanced step by
+# step and the output image of any module is viewed as a NumPy array without
+# copying it.
+#
+# The library is built with "make lib" in the COREM folder. It is searched for
+# in the path of the environment variable COREM_LIB and then in the COREM folder.
+#
+# Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+# <pablomc@ugr.es>
+
+import ctypes
+import os
+
+import numpy as np
+
+_c_double_p = ctypes.POINTER(ctypes.c_double)
+_c_int_p = ctypes.POINTER(ctypes.c_int)
+
+def _load_library(lib_path=None):
+    if lib_path is None:
+        lib_path = os.environ.get('COREM_LIB',
+            os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'libcorem.so'))
+    lib = ctypes.CDLL(lib_path)
+
+    lib.corem_create.restype = ctypes.c_void_p
+    lib.corem_create.argtypes = []
+    lib.corem_destroy.restype = None
+    lib.corem_destroy.argtypes = [ctypes.c_void_p]
+    lib.corem_load_file.restype = ctypes.c_int
+    lib.corem_load_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    lib.corem_load_script.restype = ctypes.c_int
+    lib.corem_load_script.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    for name in ['corem_size_x', 'corem_size_y', 'corem_batch_size', 'corem_total_time', 'corem_current_time', 'corem_number_modules']:
+        getattr(lib, name).restype = ctypes.c_int
+        getattr(lib, name).argtypes = [ctypes.c_void_p]
+    lib.corem_time_step.restype = ctypes.c_double
+    lib.corem_time_step.argtypes = [ctypes.c_void_p]
+    lib.corem_push_frame.restype = ctypes.c_int
+    lib.corem_push_frame.argtypes = [ctypes.c_void_p, _c_double_p, ctypes.c_long]
+    lib.corem_input_channels.restype = ctypes.c_int
+    lib.corem_input_channels.argtypes = [ctypes.c_void_p]
+    lib.corem_step.restype = ctypes.c_int
+    lib.corem_step.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.corem_module_handle.restype = ctypes.c_int
+    lib.corem_module_handle.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    lib.corem_module_id.restype = ctypes.c_char_p
+    lib.corem_module_id.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.corem_module_output.restype = _c_double_p
+    lib.corem_module_output.argtypes = [ctypes.c_void_p, ctypes.c_int, _c_int_p, _c_int_p, _c_int_p]
+    lib.corem_output_values.restype = ctypes.c_int
+    lib.corem_output_values.argtypes = [ctypes.c_void_p, ctypes.c_long, ctypes.c_long, _c_double_p]
+    return lib
+
+class Retina(object):
+    """Retina model simulated by the COREM library.
+
+    Frames and module outputs are arrays of shape (height, width) = (sizeX, sizeY),
+    or (channels, height, width) for color images.
+    """
+
+    def __init__(self, script_file=None, script=None, lib_path=None):
+        self._lib = _load_library(lib_path)
+        self._retina = self._lib.corem_create()
+        self._frame = None # Reference to the frame used by the retina (it is not copied)
+        if script_file is not None:
+            self.load_file(script_file)
+        elif script is not None:
+            self.load_script(script)
+
+    def close(self):
+        if self._retina is not None:
+            self._lib.corem_destroy(self._retina)
+            self._retina = None
+            self._frame = None
+
+    def __del__(self):
+        self.close()
+
+    # Model loading
+
+    def load_file(self, script_file):
+        if not self._lib.corem_load_file(self._retina, script_file.encode()):
+            raise RuntimeError("Retina script could not be loaded: " + script_file)
+
+    def load_script(self, script):
+        if not self._lib.corem_load_script(self._retina, script.encode()):
+            raise RuntimeError("Retina script could not be loaded")
+
+    # Simulation parameters
+
+    @property
+    def size(self):
+        return (self._lib.corem_size_x(self._retina), self._lib.corem_size_y(self._retina))
+
+    @property
+    def batch_size(self):
+        return self._lib.corem_batch_size(self._retina)
+
+    @property
+    def input_channels(self):
+        """Number of channels of the frames of the buffer input (0 if there is none)."""
+        return self._lib.corem_input_channels(self._retina)
+
+    @property
+    def frame_shape(self):
+        """Shape of the frames of the buffer input: (rows, columns), preceded by the
+        batch size in batch mode and by the channels for color frames."""
+        shape = self.size
+        if self.batch_size > 1:
+            shape = (self.batch_size,) + shape
+        if self.input_channels > 1:
+            shape = (self.input_channels,) + shape
+        return shape
+
+    @property
+    def time_step(self):
+        return self._lib.corem_time_step(self._retina)
+
+    @property
+    def total_time(self):
+        return self._lib.corem_total_time(self._retina)
+
+    @property
+    def current_time(self):
+        return self._lib.corem_current_time(self._retina)
+
+    # Simulation
+
+    def push_frame(self, frame):
+        """Set a new input frame of the buffer input of the script. A C-contiguous
+        float64 array is used by the retina without copying it. In batch mode the
+        frame contains one image per stimulus: shape (batch, rows, columns) for
+        luminance frames (see frame_shape)."""
+        frame = np.ascontiguousarray(frame, dtype=np.float64)
+        if self.input_channels == 0:
+            raise RuntimeError("The retina script does not declare a buffer input")
+        if frame.shape != self.frame_shape:
+            raise ValueError("Wrong frame shape %s: %s expected" % (frame.shape, self.frame_shape))
+        if not self._lib.corem_push_frame(self._retina, frame.ctypes.data_as(_c_double_p), frame.size):
+            raise ValueError("Wrong frame size %d" % frame.size)
+        self._frame = frame # Keep the buffer alive while the retina uses it
+
+    def step(self, n=1):
+        """Simulate n steps and return the number of steps simulated."""
+        return self._lib.corem_step(self._retina, n)
+
+    # Module outputs
+
+    def modules(self):
+        return [self._lib.corem_module_id(self._retina, k).decode()
+                for k in range(self._lib.corem_number_modules(self._retina))]
+
+    def handle(self, module_id):
+        handle = self._lib.corem_module_handle(self._retina, module_id.encode())
+        if handle < 0:
+            raise KeyError(module_id)
+        return handle
+
+    def output(self, module):
+        """NumPy view of the output image of a module (ID or handle). The view shares
+        the module buffer, so its values change when the simulation advances.
+        In batch mode the view has one image per stimulus (axis before the rows)."""
+        handle = module if isinstance(module, int) else self.handle(module)
+        width, height, channels = ctypes.c_int(), ctypes.c_int(), ctypes.c_int()
+        data = self._lib.corem_module_output(self._retina, handle,
+            ctypes.byref(width), ctypes.byref(height), ctypes.byref(channels))
+        if not data:
+            return None
+        shape = (channels.value, height.value, width.value)
+        if self.batch_size > 1:
+            shape = (channels.value, self.batch_size, height.value, width.value)
+        view = np.ctypeslib.as_array(data, shape=shape)
+        return view[0] if channels.value == 1 else view
+
+    def output_values(self, first=0, count=None):
+        """Values of the Output module layers (indexed by cell number, as in NEST)."""
+        if count is None:
+            count = self.size[0] * self.size[1]
+        values = np.empty(count, dtype=np.float64)
+        self._lib.corem_output_values(self._retina, first, count, values.ctypes.data_as(_c_double_p))
+        return values
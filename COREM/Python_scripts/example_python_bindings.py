@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Example that illustrates how to run COREM inside the Python interpreter with the
+# Python bindings (corem.py). A simple outer retina is fed with a bar that moves
+# across the visual field and the response of the bipolar cells is read at every
+# step without files. The simulation is repeated for several widths of the
+# horizontal-cell surround (parameter sweep). The COREM library must be built
+# first with "make lib" in the COREM folder.
+
+import numpy as np
+import sys,os
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import corem
+
+# Retina size and simulation time (ms)
+sizeX = 32
+sizeY = 32
+simTime = 200
+
+script = """
+retina.TempStep('1')
+retina.SimTime('%d')
+retina.NumTrials('1')
+retina.PixelsPerDegree({'10'})
+retina.Input('buffer',{'sizeX','%d','sizeY','%d','channels','1'})
+retina.Create('LinearFilter','tmp_photoreceptors',{'type','Gamma','tau','10.0','n','3.0'})
+retina.Create('GaussFilter','Gauss_horizontal',{'sigma','%f','spaceVariantSigma','False'})
+retina.Create('LinearFilter','tmp_horizontal',{'type','Exp','tau','20.0'})
+retina.Connect('L_cones','tmp_photoreceptors','Current')
+retina.Connect('tmp_photoreceptors','Gauss_horizontal','Current')
+retina.Connect('Gauss_horizontal','tmp_horizontal','Current')
+retina.Create('StaticNonLinearity','bipolar',{'slope','1.0','offset','0.0','exponent','1.0'})
+retina.Connect({'tmp_photoreceptors',-,'tmp_horizontal'},'bipolar','Current')
+retina.Connect('bipolar','Output','Current')
+"""
+
+# Input frames: a bright vertical bar moving to the right (one frame per step)
+frames = np.zeros((simTime, sizeX, sizeY))
+for t in range(simTime):
+    frames[t, :, (t // 5) % sizeY] = 100.0
+
+for sigma in [0.1, 0.2, 0.4]:
+    retina = corem.Retina(script=script % (simTime, sizeX, sizeY, sigma))
+    bipolar = retina.output('bipolar') # view of the module output (no copy)
+
+    response = np.zeros(simTime)
+    for t in range(simTime):
+        retina.push_frame(frames[t]) # the frame is not copied
+        retina.step()
+        response[t] = bipolar[sizeX // 2, sizeY // 2]
+
+    print("sigma = %.1f deg: peak response of the central bipolar cell = %.3f" % (sigma, response.max()))
+    retina.close()
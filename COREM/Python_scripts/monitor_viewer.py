@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Example viewer of the retina activity published by a monitor output module, e.g.:
+#   retina.Output('monitor','Output_monitor','unix:results/monitor.sock',{'Downsample','2','FramePeriod','10','Probe_x','5','Probe_y','5'})
+#   retina.Connect('SNL_ganglion','Output_monitor','Current')
+# Run COREM and then this script (from the COREM directory):
+#   python monitor_viewer.py unix:results/monitor.sock
+# Frames are drawn with matplotlib if it is available, otherwise a summary of each
+# received message is printed.
+
+import socket
+import struct
+import sys
+
+MONITOR_MAGIC = 0x4D524F43
+HEADER = struct.Struct('=IHHId')
+FRAME_MSG = 1
+SAMPLES_MSG = 2
+
+def connect(url):
+    if url.startswith('unix:'):
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        s.connect(url[len('unix:'):])
+    else: # tcp://host:port
+        host, port = url[len('tcp://'):].rsplit(':', 1)
+        if host == 'passive':
+            host = 'localhost'
+        s = socket.create_connection((host, int(port)))
+    return s
+
+def recv_all(s, n):
+    data = b''
+    while len(data) < n:
+        chunk = s.recv(n - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def main():
+    url = sys.argv[1] if len(sys.argv) > 1 else 'unix:results/monitor.sock'
+    try:
+        import matplotlib.pyplot as plt
+        import numpy as np
+        plt.ion()
+        images = {}
+    except ImportError:
+        plt = None
+
+    s = connect(url)
+    while True:
+        header = recv_all(s, HEADER.size)
+        if header is None:
+            break
+        magic, msg_type, port, length, sim_time = HEADER.unpack(header)
+        if magic != MONITOR_MAGIC:
+            print('Incorrect message received')
+            break
+        payload = recv_all(s, length)
+        if payload is None:
+            break
+
+        if msg_type == FRAME_MSG:
+            width, height, vmin, vmax = struct.unpack_from('=HHff', payload)
+            pixels = payload[12:]
+            if plt is None:
+                print('t=%g ms port %d: frame %dx%d range [%g, %g]' % (sim_time, port, width, height, vmin, vmax))
+            else:
+                frame = vmin + np.frombuffer(pixels, dtype=np.uint8).reshape(height, width) * ((vmax - vmin) / 255.0)
+                if port not in images:
+                    plt.figure(port)
+                    images[port] = plt.imshow(frame, cmap='jet')
+                    plt.colorbar()
+                images[port].set_data(frame)
+                images[port].set_clim(vmin, vmax)
+                plt.figure(port).canvas.set_window_title('port %d, t = %g ms' % (port, sim_time))
+                plt.pause(0.001)
+        elif msg_type == SAMPLES_MSG:
+            count, = struct.unpack_from('=I', payload)
+            values = struct.unpack_from('=%df' % count, payload, 4)
+            if plt is None:
+                print('t=%g ms port %d: samples %s' % (sim_time, port, ' '.join('%g' % v for v in values)))
+
+if __name__ == '__main__':
+    main()
@@ -18,6 +18,7 @@
 retina.TempStep('5') # simulation step (in ms)
 retina.SimTime('40000') # simulation time (in ms)
 retina.NumTrials('30') # number of trials
+retina.RandomSeed('0') # seed of the random noise (each trial uses different random streams)
 retina.PixelsPerDegree({'1'}) # pixels per degree of visual angle
 retina.DisplayDelay('0') # display delay
 retina.DisplayZoom({'10.0'}) # display zoom
@@ -25,6 +26,7 @@ retina.DisplayWindows('3') # Displays per row
 
 ### Visual input ###
 
+# Spatiotemporal (checkerboard) noise: append e.g. 'checkerSize','4','binary','1' to the parameter list
 retina.Input('whiteNoise',{'mean','0.5','contrast1','0.5','contrast2','0.1','period','1.0','switch','20000','sizeX','1','sizeY','1'})
 
 ### Creation of computational retinal microcircuits ###
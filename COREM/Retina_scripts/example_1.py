@@ -20,6 +20,7 @@ retina.SimTime('1200') # simulation time (in ms)
 retina.NumTrials('1') # number of trials
 retina.PixelsPerDegree({'5'}) # pixels per degree of visual angle
 retina.DisplayDelay('0') # display delay
+retina.DisplayRefreshRate('25') # maximum number of frames rendered per second
 retina.DisplayZoom({'10.0'}) # display zoom
 retina.DisplayWindows('3') # Display windows per row
 
@@ -0,0 +1,139 @@
+#include "BufferInput.h"
+
+BufferInput::BufferInput(int x, int y, double temporal_step):module(x,y,temporal_step){
+    Frame_sizeX = 0;
+    Frame_sizeY = 0;
+    Channels = 1;
+
+    outputImage = new CImg<double> (sizeY, sizeX, 1, Channels, 0.0);
+}
+
+BufferInput::BufferInput(const BufferInput &copy):module(copy){
+    Frame_sizeX = copy.Frame_sizeX;
+    Frame_sizeY = copy.Frame_sizeY;
+    Channels = copy.Channels;
+
+    outputImage = new CImg<double>(*copy.outputImage, false); // The copy does not share the buffer
+}
+
+BufferInput::~BufferInput(){
+    if(outputImage != NULL)
+        delete outputImage;
+}
+
+//------------------------------------------------------------------------------//
+
+bool BufferInput::allocateValues(){
+    module::allocateValues(); // Call the allocateValues() method of the base class
+
+    // The frame size specified for the input determines the retina size
+    if(Frame_sizeX > 0)
+        sizeX = Frame_sizeX;
+    if(Frame_sizeY > 0)
+        sizeY = Frame_sizeY;
+
+    // Black frame until the first buffer is set (a shared buffer is released first)
+    outputImage->assign();
+    outputImage->assign(sizeY, sizeX, batchSize, Channels, 0.0);
+    outputVersion++;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------//
+
+bool BufferInput::set_Frame_sizeX(int x){
+    bool ret_correct;
+    if (x>0) {
+        Frame_sizeX = x;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool BufferInput::set_Frame_sizeY(int y){
+    bool ret_correct;
+    if (y>0) {
+        Frame_sizeY = y;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool BufferInput::set_Channels(int n_channels){
+    bool ret_correct;
+    if (n_channels==1 || n_channels==3) {
+        Channels = n_channels;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+int BufferInput::getChannels(){
+    return(Channels);
+}
+
+//------------------------------------------------------------------------------//
+
+int BufferInput::setParameters(vector<double> params, vector<string> paramID){
+
+    int err_param_num=0; // default, no error
+
+    for (vector<double>::size_type i = 0;i < params.size() && err_param_num==0;i++){
+        const char * s = paramID[i].c_str();
+
+        if (strcmp(s,"sizeX")==0){
+            if(!set_Frame_sizeX((int)(params[i])))
+                err_param_num = -(i+1); // Error: invalid value of parameter i+1
+        } else if (strcmp(s,"sizeY")==0){
+            if(!set_Frame_sizeY((int)(params[i])))
+                err_param_num = -(i+1);
+        } else if (strcmp(s,"channels")==0){
+            if(!set_Channels((int)(params[i])))
+                err_param_num = -(i+1);
+        } else{
+              err_param_num = i+1; // Error: unknown name of parameter i+1
+        }
+    }
+    return err_param_num;
+}
+
+//------------------------------------------------------------------------------//
+
+long BufferInput::getFrameSize(){
+    return((long)sizeX*sizeY*batchSize*Channels);
+}
+
+bool BufferInput::setBuffer(double *frame, long n_values){
+    bool ret_correct;
+    if(frame != NULL && n_values == getFrameSize()){
+        outputImage->assign(frame, sizeY, sizeX, batchSize, Channels, true); // Shared image: no copy
+        outputVersion++; // New frame
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+//------------------------------------------------------------------------------//
+
+// This method can only be used to set the simulation time
+void BufferInput::feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port){
+    simTime = sim_time;
+}
+
+void BufferInput::update(){
+}
+
+//------------------------------------------------------------------------------//
+
+CImg<double>* BufferInput::getOutput(){
+    return outputImage;
+}
+
+bool BufferInput::isDummy() {
+    return false;
+}
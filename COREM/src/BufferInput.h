@@ -0,0 +1,75 @@
+#ifndef BUFFERINPUT_H
+#define BUFFERINPUT_H
+
+/* BeginDocumentation
+ * Name: BufferInput
+ *
+ * Description: Special retina module that obtains the retina input images from a frame
+ *              buffer provided by the program in which the retina is embedded (see corem_api.h).
+ *              The buffer is used as the module output without copying it, so it must remain
+ *              valid until a new buffer is set. Frames are stored as CImg images: channel by
+ *              channel, row by row (sizeY pixels per row). Each call to setBuffer() (even with
+ *              the same buffer) indicates that a new frame is available. In batch mode (see
+ *              Retina::setBatchSize()) the frames contain one image per stimulus of the batch
+ *              in each channel (sizeX*sizeY*batchSize*channels values).
+ *
+ * Parameters:
+ *   sizeX, sizeY -> frame size (if not specified, the retina size is used).
+ *   channels -> number of color channels of the frames: 1 (luminance) or 3 (RGB).
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ * Author: Richard R. Carrillo. University of Granada. CITIC-UGR. Spain.
+ *
+ * SeeAlso: module, SequenceInput, StreamingInput
+ */
+
+#include "module.h"
+
+using namespace cimg_library;
+using namespace std;
+
+class BufferInput: public module{
+protected:
+    // Output image: an internal (black) image until a buffer is set, then shared with the buffer
+    CImg<double> *outputImage;
+    int Frame_sizeX, Frame_sizeY; // Frame size specified by the script (0 if not specified)
+    int Channels; // Number of channels of the frames
+
+public:
+    // Constructor, copy, destructor.
+    BufferInput(int x=1, int y=1, double temporal_step=1.0);
+    BufferInput(const BufferInput& copy);
+    ~BufferInput(void);
+
+    // Allocate values and set protected parameters
+    virtual bool allocateValues();
+
+    // These functions are mainly used by setParameters() to set object parameter properties after the object is created
+    bool set_Frame_sizeX(int x);
+    bool set_Frame_sizeY(int y);
+    bool set_Channels(int n_channels);
+    int getChannels();
+
+    // Use an external buffer of n_values values as the new input frame without copying it. It returns
+    // false if the buffer does not have the frame size (sizeX*sizeY*batchSize*channels values)
+    bool setBuffer(double *frame, long n_values);
+    long getFrameSize();
+
+    // Only used to update the object simulation time
+    virtual void feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port);
+
+    // The frame only changes when a new buffer is set
+    virtual void update();
+
+    // set Parameters
+    virtual int setParameters(vector<double> params, vector<string> paramID);
+
+    // Get output image (current frame)
+    virtual CImg<double>* getOutput();
+
+    // Returns false to indicate that this class performs computation
+    virtual bool isDummy();
+};
+
+#endif // BUFFERINPUT_H
@@ -0,0 +1,171 @@
+#include <cmath>
+#include "CounterRNG.h"
+#include "constants.h"
+
+// Philox4x32 constants
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+// Minimum number of values to generate a batch with several threads
+#define RNG_PARALLEL_MIN_SIZE 16384
+
+uint64_t CounterRNG::globalSeed = 0;
+uint64_t CounterRNG::currentTrial = 0;
+
+//------------------------------------------------------------------------------//
+
+void CounterRNG::setSeed(uint64_t seed){
+    globalSeed = seed;
+}
+
+uint64_t CounterRNG::getSeed(){
+    return globalSeed;
+}
+
+void CounterRNG::setTrial(uint64_t trial){
+    currentTrial = trial;
+}
+
+uint64_t CounterRNG::streamKey(const string &name){
+    return(streamKey(name, currentTrial));
+}
+
+// 64-bit FNV-1a hash of the name followed by a SplitMix64 mix of the seed and trial
+uint64_t CounterRNG::streamKey(const string &name, uint64_t trial){
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for(size_t i=0;i<name.size();i++){
+        h ^= (unsigned char)name[i];
+        h *= 0x100000001B3ULL;
+    }
+    h ^= globalSeed + 0x9E3779B97F4A7C15ULL + (h<<6) + (h>>2);
+    h ^= (trial + 1) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return(h ^ (h >> 31));
+}
+
+//------------------------------------------------------------------------------//
+
+void CounterRNG::philox(const uint32_t counter_in[4], uint64_t key, uint32_t out[4]){
+    uint32_t c0 = counter_in[0], c1 = counter_in[1], c2 = counter_in[2], c3 = counter_in[3];
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+
+    for(int r=0;r<PHILOX_ROUNDS;r++){
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+void CounterRNG::uniformPair(uint64_t key, uint64_t sub, uint64_t ctr, double &u1, double &u2){
+    uint32_t counter[4], out[4];
+
+    counter[0] = (uint32_t)ctr;
+    counter[1] = (uint32_t)(ctr >> 32);
+    counter[2] = (uint32_t)sub;
+    counter[3] = (uint32_t)(sub >> 32);
+    philox(counter, key, out);
+    // 53 random bits for each double
+    u1 = (double)((((uint64_t)out[0] << 32) | out[1]) >> 11) * (1.0/9007199254740992.0);
+    u2 = (double)((((uint64_t)out[2] << 32) | out[3]) >> 11) * (1.0/9007199254740992.0);
+}
+
+void CounterRNG::fillUniform(uint64_t key, uint64_t sub, uint64_t first_ctr, double *out, size_t n){
+    long n_pairs = (long)((n+1)/2);
+
+    #pragma omp parallel for if(n >= RNG_PARALLEL_MIN_SIZE)
+    for(long j=0;j<n_pairs;j++){
+        double u1, u2;
+        uniformPair(key, sub, first_ctr+j, u1, u2);
+        out[2*j] = u1;
+        if((size_t)(2*j+1) < n)
+            out[2*j+1] = u2;
+    }
+}
+
+// Box-Muller transform: each counter number produces two normal numbers
+void CounterRNG::fillNormal(uint64_t key, uint64_t sub, uint64_t first_ctr, double mean, double sigma, double *out, size_t n){
+    long n_pairs = (long)((n+1)/2);
+
+    #pragma omp parallel for if(n >= RNG_PARALLEL_MIN_SIZE)
+    for(long j=0;j<n_pairs;j++){
+        double u1, u2;
+        uniformPair(key, sub, first_ctr+j, u1, u2);
+        double radius = sqrt(-2.0*log(1.0-u1)); // 1-u1 is in (0,1]
+        out[2*j] = mean + sigma*radius*cos(TWOPI*u2);
+        if((size_t)(2*j+1) < n)
+            out[2*j+1] = mean + sigma*radius*sin(TWOPI*u2);
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+RandomStream::RandomStream(uint64_t stream_key, uint64_t sub){
+    seed(stream_key, sub);
+}
+
+void RandomStream::seed(uint64_t stream_key, uint64_t sub){
+    key = stream_key;
+    substream = sub;
+    counter = 0;
+    buffered = 0;
+    hasSpareNormal = false;
+}
+
+double RandomStream::uniform(){
+    if(buffered == 0){
+        CounterRNG::uniformPair(key, substream, counter++, buffer[1], buffer[0]);
+        buffered = 2;
+    }
+    return(buffer[--buffered]);
+}
+
+double RandomStream::normal(double mean, double sigma){
+    double z;
+    if(hasSpareNormal){
+        z = spareNormal;
+        hasSpareNormal = false;
+    } else {
+        double u1 = uniform(), u2 = uniform();
+        double radius = sqrt(-2.0*log(1.0-u1));
+        z = radius*cos(TWOPI*u2);
+        spareNormal = radius*sin(TWOPI*u2);
+        hasSpareNormal = true;
+    }
+    return(mean + sigma*z);
+}
+
+// Marsaglia and Tsang method. For shape < 1, gamma(shape+1) is scaled by u^(1/shape)
+double RandomStream::gamma(double shape, double scale){
+    double boost = 1.0;
+    if(shape < 1.0){
+        boost = pow(1.0-uniform(), 1.0/shape);
+        shape += 1.0;
+    }
+
+    double d = shape - 1.0/3.0;
+    double c = 1.0/sqrt(9.0*d);
+    double x, v, u;
+    while(true){
+        do{
+            x = normal();
+            v = 1.0 + c*x;
+        } while(v <= 0.0);
+        v = v*v*v;
+        u = uniform();
+        if(u < 1.0 - 0.0331*x*x*x*x || log(u) < 0.5*x*x + d*(1.0 - v + log(v)))
+            break;
+    }
+    return(d*v*scale*boost);
+}
@@ -0,0 +1,84 @@
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+/* BeginDocumentation
+ * Name: CounterRNG
+ *
+ * Description: counter-based random number generation (Philox4x32-10 [1]) shared by all
+ * the stochastic retina components (whiteNoise, fixationalMovGrating and SpikingOutput).
+ * A random number is a pure function of a key and a counter, so the numbers do not depend
+ * on the order in which they are generated: simulations are reproducible and serial and
+ * parallel runs give identical results.
+ * The key of each stream is obtained from the global seed (script command RandomSeed),
+ * the current trial and a stream name (module ID). Each stream is divided in substreams
+ * (e.g. one per pixel) which are independent of each other.
+ *
+ * [1] Salmon, John K., et al. "Parallel random numbers: as easy as 1, 2, 3." Proceedings of
+ * the 2011 International Conference for High Performance Computing, Networking, Storage
+ * and Analysis. ACM, 2011.
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ *
+ * SeeAlso: whiteNoise, fixationalMovGrating, SpikingOutput
+ */
+
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+class CounterRNG{
+protected:
+    static uint64_t globalSeed;
+    static uint64_t currentTrial;
+
+public:
+    // Global seed and trial used to derive the stream keys
+    static void setSeed(uint64_t seed);
+    static uint64_t getSeed();
+    static void setTrial(uint64_t trial);
+
+    // Key of a stream from its name (and the current or a specified trial)
+    static uint64_t streamKey(const string &name);
+    static uint64_t streamKey(const string &name, uint64_t trial);
+
+    // Philox4x32-10 block: 4 random 32-bit words for a 128-bit counter and a 64-bit key
+    static void philox(const uint32_t counter_in[4], uint64_t key, uint32_t out[4]);
+    // Two uniform numbers in [0,1) for counter number ctr of substream sub
+    static void uniformPair(uint64_t key, uint64_t sub, uint64_t ctr, double &u1, double &u2);
+
+    // Batch generation of n numbers of a substream starting at counter number first_ctr
+    // (each counter number produces two numbers). The generation is multithreaded for
+    // large n and the result does not depend on the number of threads.
+    static void fillUniform(uint64_t key, uint64_t sub, uint64_t first_ctr, double *out, size_t n);
+    static void fillNormal(uint64_t key, uint64_t sub, uint64_t first_ctr, double mean, double sigma, double *out, size_t n);
+};
+
+// Sequential generator of one substream
+class RandomStream{
+protected:
+    uint64_t key;
+    uint64_t substream;
+    uint64_t counter; // Number of the next Philox block of this substream
+
+    double buffer[2]; // Uniform numbers of the last block not used yet
+    int buffered;
+    double spareNormal; // Second number generated by Box-Muller transform
+    bool hasSpareNormal;
+
+public:
+    RandomStream(uint64_t stream_key=0, uint64_t sub=0);
+
+    // Restart the stream with a new key and substream
+    void seed(uint64_t stream_key, uint64_t sub=0);
+
+    // Uniform number in [0,1)
+    double uniform();
+    // Normal number
+    double normal(double mean=0.0, double sigma=1.0);
+    // Gamma number (shape k and scale theta)
+    double gamma(double shape, double scale=1.0);
+};
+
+#endif // COUNTERRNG_H
@@ -1,6 +1,9 @@
 #include <cstddef> // for size_t type (used as loop index instead of int to avoid compile warnings)
 #include "DisplayManager.h"
 
+#define NEW_FRAME_FLAG 4 // Bit of mailboxFrame indicating that the mailbox has not been rendered yet
+#define RENDER_IDLE_SLEEP 2 // Milliseconds slept by the render thread when the mailbox is empty
+
 DisplayManager::DisplayManager(int x, int y){
     sizeX = x;
     sizeY = y;
@@ -10,14 +13,20 @@ DisplayManager::DisplayManager(int x, int y){
 
     displayZoom = 0;
     delay = 0;
+    refreshRate = 0;
     imagesPerRow=4;
 
     numberModules = 0;
     valuesAllocated = false;
 
+    writeFrame = 0;
+    mailboxFrame = 1;
+    readFrame = 2;
+    framePublished = false;
+    renderThreadStarted = false;
+    stopRendering = false;
+
     // Indicate to destructor that these variables have not been allocated yet:
-    intermediateImages = NULL;
-    inputImage = NULL;
     templateBar = NULL;
     bars = NULL;
 }
@@ -27,6 +36,9 @@ DisplayManager::DisplayManager(const DisplayManager& copy){
 }
 
 DisplayManager::~DisplayManager(void){
+    // The render thread must not access the displays while they are destroyed
+    stopRenderThread();
+
     // Free memory allocated in several parts of the class
     while(!displays.empty()) {
         delete displays.back();
@@ -38,21 +50,12 @@ DisplayManager::~DisplayManager(void){
         multimeters.pop_back();
     }
 
-    if(intermediateImages != NULL){
-        for (int i=0;i<numberModules-1;i++)
-            delete intermediateImages[i];
-        delete[] intermediateImages;
-    }
-
     if(bars != NULL){
         for (int i=0;i<numberModules-1;i++)
             delete bars[i];
         delete[] bars;
     }
 
-    if(inputImage != NULL)
-        delete inputImage;
-        
     if(templateBar != NULL)
         delete templateBar;
 }
@@ -67,6 +70,7 @@ void DisplayManager::reset(){
 
     displayZoom = 0;
     delay = 0;
+    refreshRate = 0;
     imagesPerRow=4;
 
     valuesAllocated = false;
@@ -142,6 +146,10 @@ void DisplayManager::setDelay(int displayDelay){
     delay = displayDelay;
 }
 
+void DisplayManager::setRefreshRate(double rate){
+    refreshRate = rate;
+}
+
 void DisplayManager::setImagesPerRow(int numberI){
     imagesPerRow = numberI;
 }
@@ -154,6 +162,15 @@ void DisplayManager::setMargin(double m, int pos){
     margin[pos]=m;
 }
 
+bool DisplayManager::isObserved(int pos, string ID){
+    if(pos >= 0 && (size_t)pos < isShown.size() && isShown[pos])
+        return true;
+    for(size_t i=0;i<moduleIDs.size();i++)
+        if(moduleIDs[i].compare(ID) == 0)
+            return true;
+    return false;
+}
+
 
 bool DisplayManager::setSimStep(double step_value){
     bool ret_correct;
@@ -265,17 +282,9 @@ void DisplayManager::addModule(int pos,string ID){
             CImgDisplay *input = new CImgDisplay(image,"Norm. input",0);
             input->move(0,0);
             displays.push_back(input);
-            inputImage = new CImg <double>(sizeY,sizeX,1,1,0.0);
         }else{
             displays.push_back(new CImgDisplay());
         }
-
-        // initialize intermediate images at the first call
-        if(numberModules > 1){
-            intermediateImages = new CImg<double>*[numberModules-1];
-            for (int i=0;i<numberModules-1;i++)
-              intermediateImages[i] = new CImg<double> (sizeY,sizeX,1,1,0.0);
-        }
     }
 
     if(pos > 0 && isShown.size() > (size_t)pos) { // display for pos==0 (Input) is create above
@@ -327,113 +336,38 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
     double newX = (double)sizeX * displayZoom;
     double newY = (double)sizeY * displayZoom;
 
-    double max=0.0,min=0.0;
-    const unsigned char color[] = {255,255,255};
-
-
-    // Display input
-    if(isShown.size() > 0 && isShown[0] && input != NULL){
-
-        CImgDisplay *d0 = displays[0];
-        *inputImage = *input;
-
-        inputImage->crop(margin[0],margin[0],0,0,sizeY-margin[0]-1,sizeX-margin[0]-1,0,inputImage->spectrum()-1,false);
-        min = inputImage->min_max(max); // find maximum and minimum values in all color channels
-        if(max-min > DBL_EPSILON) // normalize Input before showing it if it has different pixel values
-            ((255*(*inputImage - min)/(max-min))).resize((int)newY,(int)newX).display(*d0);
-        else // If we normalize we lose the offset and so all the informaton: we better don't normalize
-            inputImage->resize((int)newY,(int)newX).display(*d0);
-    }
-
-    // Update windows
-    if (numberModules>0 && simTime==0){
-        bars = new CImg<double>*[numberModules-1];
-        templateBar = new CImg <double>(50,(int)newX, 1, 1);
-        for(int i=0;i<numberModules-1;i++){
-            bars[i] = new CImg <double>(50,(int)newX, 1, 1);
-        }
-    }
-
-    // copy interm. images
-    for(int i=0;i<numberModules-1;i++){
-        module* m = retina.getModule(i+1);
-        CImg<double> *module_output = m->getOutput();
-        if(module_output != NULL)
-            *intermediateImages[i] = *module_output;
-    }
-
-    // show modules
-    for(int k=0;k<numberModules-1;k++){
-        if(isShown[k+1]){
-
-            CImgDisplay *d = displays[k+1];
-
-            // Color Bar
-            *bars[k]=*templateBar;
-            cimg_forXY(*(bars[k]),x,y) {
-                (*bars[k])(x,(int)newX-y-1,0,0)=255*((double)y/newX);
-            }
-            bars[k]->map(CImg<double>::jet_LUT256());
-
-
-            // find maximum and minimum values
-            min = findMin(intermediateImages[k]);
-            max = findMax(intermediateImages[k]);
-
-            // draw them
-            std::ostringstream strs1,strs2;
-
-            if(abs(min)<100)
-                strs1 << min;
-            else
-                strs1 << (int)min;
-
-            string str1 = strs1.str();
-            string min_value_text = str1.substr(0,4);
-
-            bars[k]->draw_text(0,bars[k]->height()-20,min_value_text.c_str(),color,0,1,20);
-
-            if(abs(max)<100)
-                strs2 << max;
-            else
-                strs2 << (int)max;
-
-            string str2 = strs2.str();
-            string max_value_text = str2.substr(0,4);
-
-            bars[k]->draw_text(0,10,max_value_text.c_str(),color,0,1,20);
-
-            // show image
-            intermediateImages[k]->crop(margin[k+1],margin[k+1],0,0,sizeY-margin[k+1]-1,sizeX-margin[k+1]-1,0,0,false);
-            if(max-min > DBL_EPSILON) // normalize image before showing it if all its pixel do not the same value
-                ((255*(*intermediateImages[k] - min)/(max-min)).map(CImg<double>::jet_LUT256()).resize((int)newY,(int)newX),*bars[k]).display(*d);
-            else // Do not normalize to preserve the pixel offset information
-                (intermediateImages[k]->map(CImg<double>::jet_LUT256()).resize((int)newY,(int)newX),*bars[k]).display(*d);
-        }
-    }
-
+    // Pass the shown layers to the render thread. The last step is always published
+    // so that the windows end up showing the final state
+    publishFrame(input, retina, simTime==totalSimTime-simStep || input == NULL);
 
     // Multimeters //
 
     if(input!=NULL) { // If the retina has input, update multimeters
+        // Input multimeters record the red channel, which is a scaled copy of luminance inputs
+        double input_gain = retina.getInputGain(0);
+
         for(size_t i=0;i<multimeters.size();i++){
             multimeter *m = multimeters[i];
-            module *n;
+            module *n = NULL;
             const char * moduleID = (moduleIDs[i]).c_str();
+            bool isInput = (strcmp(moduleID, "Input") == 0);
 
-            // find target module
-            if(strcmp(moduleID, "Input") != 0){
-                for(int j=1;j<retina.getNumberModules();j++){
-                    n = retina.getModule(j);
-                    if(n->checkID(moduleID)){
-                        break;
-                    }
+            // find target module (the multimeter is skipped if it does not exist)
+            if(!isInput){
+                for(int j=1;j<retina.getNumberModules() && n==NULL;j++){
+                    if(retina.getModule(j)->checkID(moduleID))
+                        n = retina.getModule(j);
                 }
+                if(n==NULL)
+                    continue;
             }
 
             // temporal and LN mult.
             if(multimeterType[i]==0 || multimeterType[i]==2){
                 vector <int> aux = multimeterParam[i];
+                // Cell of the module grid (it may be downsampled) which contains the recorded pixel
+                int factor = isInput? 1 : n->getDownsample();
+                int cell_x = aux[0]/factor, cell_y = aux[1]/factor;
 
                 // Initialize multimeters
                 if (simTime<1){
@@ -451,14 +385,14 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
                         m->saveAllVectors(numberTrials);
                 }
 
-                if(strcmp(moduleID, "Input") == 0){
+                if(isInput){
                     // LN multimeter
                     if (multimeterType[i]==2){
-                        m->recordInputLNAnalysis((*input)(aux[0],aux[1],0,0),numberTrials);
-                        m->recordValueLNAnalysis((*input)(aux[0],aux[1],0,0),numberTrials);
+                        m->recordInputLNAnalysis(input_gain*(*input)(aux[0],aux[1],0,0),numberTrials);
+                        m->recordValueLNAnalysis(input_gain*(*input)(aux[0],aux[1],0,0),numberTrials);
                     // time multimeter
                     }else{
-                        m->recordValue((*input)(aux[0],aux[1],0,0),0);
+                        m->recordValue(input_gain*(*input)(aux[0],aux[1],0,0),0);
                     }
 
 
@@ -467,8 +401,8 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
                     if(module_output != NULL){
                         // LN multimeter
                         if (multimeterType[i]==2){
-                            m->recordInputLNAnalysis((*input)(aux[0],aux[1],0,0),numberTrials);
-                            m->recordValueLNAnalysis((*module_output)(aux[0],aux[1],0,0),numberTrials);
+                            m->recordInputLNAnalysis(input_gain*(*input)(aux[0],aux[1],0,0),numberTrials);
+                            m->recordValueLNAnalysis((*module_output)(cell_x,cell_y,0,0),numberTrials);
                         }
                         // time multimeter
                         else{
@@ -482,7 +416,7 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
                                     }
                                 }
                             }else{
-                                m->recordValue((*module_output)(aux[0],aux[1],0,0),0);
+                                m->recordValue((*module_output)(cell_x,cell_y,0,0),0);
                             }
                         }
                     }
@@ -506,21 +440,22 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
 
                     if(isShown[numberModules+i]==true){
 
-                        if(strcmp(moduleID, "Input") == 0){
+                        if(isInput){
+                            CImg<double> red_input = input->get_shared_channel(0)*input_gain;
 
                             if(aux[0]>0)
-                                m->showSpatialProfile(input,true,aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
+                                m->showSpatialProfile(&red_input,true,aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
 
                             else
-                                m->showSpatialProfile(input,false,-aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
+                                m->showSpatialProfile(&red_input,false,-aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
                         }else{
                             CImg <double> image ((int)newY,(int)newX,1,1,0.0);
                             CImg<double> *module_output = n->getOutput();
                             if(module_output != NULL) {
                                 if(aux[0]>0)
-                                    m->showSpatialProfile(module_output,true,aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
+                                    m->showSpatialProfile(module_output,true,aux[0]/n->getDownsample(),multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
                                 else
-                                    m->showSpatialProfile(module_output,false,-aux[0],multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
+                                    m->showSpatialProfile(module_output,false,-aux[0]/n->getDownsample(),multimeterIDs[i],(int)last_col*(newY+80.0),(int)last_row*(newX+80.0),true,true,multimeterIDs[i]);
                             }
                         }
                     }
@@ -584,9 +519,193 @@ void DisplayManager::updateDisplay(CImg <double> *input, Retina &retina, int sim
             }
         }
     }
-    // Show displays if there's an input display
-    if(isShown.size() > 0 && isShown[0])
-        displays[0]->wait(delay);
+    // A display delay slows down the simulation on purpose (rendering does not)
+    if(delay > 0 && renderThreadStarted)
+        cimg::wait((unsigned int)delay);
+}
+
+//------------------------------------------------------------------------------//
+
+
+void DisplayManager::publishFrame(CImg <double> *input, Retina &retina, bool force){
+    bool any_shown = false;
+    for(int k=0;k<numberModules && (size_t)k<isShown.size();k++)
+        any_shown = any_shown || isShown[k];
+    if(!any_shown)
+        return;
+
+    // Frame decimation: skip the copy if the previous snapshot is too recent
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if(framePublished && !force && refreshRate > 0){
+        double elapsed = chrono::duration<double>(now - lastPublishTime).count();
+        if(elapsed < 1.0/refreshRate)
+            return;
+    }
+
+    // Copy the shown layers into the write slot (CImg reuses the buffers of the same size)
+    display_frame &frame = frames[writeFrame];
+    if(isShown[0] && input != NULL){
+        double gains[3] = {retina.getInputGain(0), retina.getInputGain(1), retina.getInputGain(2)};
+        // In batch mode the first stimulus is shown
+        const CImg<double> input_slice = (input->depth() > 1)? input->get_slice(0) : CImg<double>(*input, true);
+        if(input_slice.spectrum() == 1 && (gains[0] != gains[1] || gains[1] != gains[2])){
+            // Luminance input with different color weights: the color image is rebuilt
+            frame.input.assign(input_slice.width(), input_slice.height(), 1, 3);
+            for(int c=0;c<3;c++)
+                frame.input.get_shared_channel(c) = input_slice*gains[c];
+        }else
+            frame.input = input_slice;
+    }else
+        frame.input.assign();
+
+    frame.layers.resize(numberModules>0? numberModules-1 : 0);
+    for(int k=0;k<numberModules-1;k++){
+        CImg<double> *module_output = NULL;
+        if(isShown[k+1])
+            module_output = retina.getModule(k+1)->getOutput();
+        if(module_output == NULL){
+            frame.layers[k].assign();
+            continue;
+        }
+        // In batch mode only the first stimulus is copied (the one shown and used for the color bar)
+        const CImg<double> output_slice = module_output->get_shared_slice(0);
+        if(output_slice.width() == sizeY && output_slice.height() == sizeX)
+            frame.layers[k] = output_slice;
+        else // Downsampled module: shown in the input grid
+            Retina::resampleImage(output_slice, retina.getModule(k+1)->getDownsample(), frame.layers[k], 1, sizeY, sizeX);
+    }
+
+    // Swap the write slot with the mailbox
+    writeFrame = mailboxFrame.exchange(writeFrame | NEW_FRAME_FLAG) & ~NEW_FRAME_FLAG;
+    lastPublishTime = now;
+    framePublished = true;
+
+    if(!renderThreadStarted){
+        stopRendering = false;
+        if(pthread_create(&renderThreadID, NULL, &DisplayManager::renderThreadEntry, (void *)this) == 0)
+            renderThreadStarted = true;
+        else
+            cout << "Error: The display render thread could not be created" << endl;
+    }
+}
+
+void *DisplayManager::renderThreadEntry(void *display_manager){
+    ((DisplayManager *)display_manager)->renderLoop();
+    return(NULL);
+}
+
+void DisplayManager::renderLoop(){
+    chrono::steady_clock::time_point last_render = chrono::steady_clock::now();
+    bool stop;
+
+    do{
+        // Read the stop request before the mailbox so that the last snapshot is always rendered
+        stop = stopRendering.load();
+        if(mailboxFrame.load() & NEW_FRAME_FLAG){
+            readFrame = mailboxFrame.exchange(readFrame) & ~NEW_FRAME_FLAG;
+            renderFrame(frames[readFrame]);
+
+            // Do not exceed the maximum refresh rate
+            if(refreshRate > 0 && !stop){
+                double elapsed = chrono::duration<double>(chrono::steady_clock::now() - last_render).count();
+                if(elapsed < 1.0/refreshRate)
+                    cimg::sleep((unsigned int)(1000.0*(1.0/refreshRate - elapsed)));
+            }
+            last_render = chrono::steady_clock::now();
+        }else if(!stop)
+            cimg::sleep(RENDER_IDLE_SLEEP);
+    }while(!stop);
+}
+
+void DisplayManager::stopRenderThread(){
+    if(renderThreadStarted){
+        stopRendering = true;
+        pthread_join(renderThreadID, NULL);
+        renderThreadStarted = false;
+    }
+}
+
+void DisplayManager::renderFrame(display_frame &frame){
+
+    double newX = (double)sizeX * displayZoom;
+    double newY = (double)sizeY * displayZoom;
+
+    double max=0.0,min=0.0;
+    const unsigned char color[] = {255,255,255};
+
+    // Display input
+    if(isShown[0] && !frame.input.is_empty()){
+
+        CImgDisplay *d0 = displays[0];
+        CImg <double> &inputImage = frame.input;
+
+        inputImage.crop(margin[0],margin[0],0,0,sizeY-margin[0]-1,sizeX-margin[0]-1,0,inputImage.spectrum()-1,false);
+        min = inputImage.min_max(max); // find maximum and minimum values in all color channels
+        if(max-min > DBL_EPSILON) // normalize Input before showing it if it has different pixel values
+            ((255*(inputImage - min)/(max-min))).resize((int)newY,(int)newX).display(*d0);
+        else // If we normalize we lose the offset and so all the informaton: we better don't normalize
+            inputImage.resize((int)newY,(int)newX).display(*d0);
+    }
+
+    // Color bars are allocated with the first rendered frame
+    if (numberModules>0 && bars == NULL){
+        bars = new CImg<double>*[numberModules-1];
+        templateBar = new CImg <double>(50,(int)newX, 1, 1);
+        for(int i=0;i<numberModules-1;i++){
+            bars[i] = new CImg <double>(50,(int)newX, 1, 1);
+        }
+    }
+
+    // show modules
+    for(int k=0;k<numberModules-1 && (size_t)k<frame.layers.size();k++){
+        if(isShown[k+1] && !frame.layers[k].is_empty()){
+
+            CImgDisplay *d = displays[k+1];
+            CImg <double> &layer = frame.layers[k];
+
+            // Color Bar
+            *bars[k]=*templateBar;
+            cimg_forXY(*(bars[k]),x,y) {
+                (*bars[k])(x,(int)newX-y-1,0,0)=255*((double)y/newX);
+            }
+            bars[k]->map(CImg<double>::jet_LUT256());
+
+
+            // find maximum and minimum values
+            min = findMin(&layer);
+            max = findMax(&layer);
+
+            // draw them
+            std::ostringstream strs1,strs2;
+
+            if(abs(min)<100)
+                strs1 << min;
+            else
+                strs1 << (int)min;
+
+            string str1 = strs1.str();
+            string min_value_text = str1.substr(0,4);
+
+            bars[k]->draw_text(0,bars[k]->height()-20,min_value_text.c_str(),color,0,1,20);
+
+            if(abs(max)<100)
+                strs2 << max;
+            else
+                strs2 << (int)max;
+
+            string str2 = strs2.str();
+            string max_value_text = str2.substr(0,4);
+
+            bars[k]->draw_text(0,10,max_value_text.c_str(),color,0,1,20);
+
+            // show image
+            layer.crop(margin[k+1],margin[k+1],0,0,sizeY-margin[k+1]-1,sizeX-margin[k+1]-1,0,0,false);
+            if(max-min > DBL_EPSILON) // normalize image before showing it if all its pixel do not the same value
+                ((255*(layer - min)/(max-min)).map(CImg<double>::jet_LUT256()).resize((int)newY,(int)newX),*bars[k]).display(*d);
+            else // Do not normalize to preserve the pixel offset information
+                (layer.map(CImg<double>::jet_LUT256()).resize((int)newY,(int)newX),*bars[k]).display(*d);
+        }
+    }
 }
 
 //------------------------------------------------------------------------------//
@@ -6,6 +6,13 @@
  *
  * Description: Displays of multimeters
  *
+ * Shown layers are rendered (normalization, LUT mapping, resizing and text drawing)
+ * by a dedicated render thread. At each simulation step updateDisplay() only copies
+ * the shown layers into a triple-buffered mailbox, which is lock-free: the simulation
+ * thread never waits for the render thread and a snapshot not consumed yet is replaced
+ * by the newest one. Snapshots are decimated to the maximum refresh rate set with
+ * the script command DisplayRefreshRate (frames per second, 0 means no limit).
+ *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
  *
@@ -13,12 +20,21 @@
  */
 
 #include <sstream>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
 #include "multimeter.h"
 #include "Retina.h"
 
 using namespace cimg_library;
 using namespace std;
 
+// Snapshot of the shown layers passed from the simulation thread to the render thread
+struct display_frame {
+    CImg<double> input; // Copy of the retina input (empty if the input is not shown)
+    vector < CImg<double> > layers; // Copy of the output of each module (empty if it is not shown)
+};
+
 class DisplayManager{
 protected:
     // Image size
@@ -31,9 +47,26 @@ protected:
      vector <bool> isShown;
      vector <double> margin;
 
-    // Buffers of displays and images generated by each module
+    // Maximum number of frames rendered per second (0 = no limit)
+    double refreshRate;
+
+    // Buffers of displays
     vector <CImgDisplay*> displays;
-    CImg<double>** intermediateImages;
+
+    // Triple buffer of snapshots shared with the render thread: the simulation thread
+    // fills frames[writeFrame], the render thread draws frames[readFrame] and the third
+    // slot is the mailbox. mailboxFrame holds the index of the mailbox slot and
+    // the NEW_FRAME_FLAG bit is set when it contains a snapshot not rendered yet.
+    display_frame frames[3];
+    int writeFrame, readFrame;
+    atomic<int> mailboxFrame;
+    chrono::steady_clock::time_point lastPublishTime;
+    bool framePublished;
+
+    // Render thread
+    pthread_t renderThreadID;
+    bool renderThreadStarted;
+    atomic<bool> stopRendering;
 
     // Buffers of multimeters and their parameters
     vector <multimeter*> multimeters;
@@ -51,9 +84,6 @@ protected:
     vector <double> LNStop;
     const char * LNFile;
 
-    // copy of input
-    CImg <double> *inputImage;
-
     // Last row to display
     int last_row,last_col;
     //Color bars
@@ -69,6 +99,15 @@ protected:
     // Simulation step
     double simStep;
 
+    // Copy shown layers into the mailbox and start the render thread the first time
+    void publishFrame(CImg <double> *input, Retina &retina, bool force);
+
+    // Render thread main loop and drawing of a snapshot
+    static void *renderThreadEntry(void *display_manager);
+    void renderLoop();
+    void renderFrame(display_frame &frame);
+    void stopRenderThread();
+
 
 public:
     // Constructor, copy, destructor.
@@ -88,6 +127,7 @@ public:
     // Other Set functions
     void setZoom(double zoom);
     void setDelay(int displayDelay);
+    void setRefreshRate(double rate);
     void setImagesPerRow(int numberI);
     void setIsShown(bool value, int pos);
     void setMargin(double m, int pos);
@@ -102,6 +142,9 @@ public:
     void addMultimeterTempSpat(string multimeterID, string moduleID, int param1, int param2, bool temporalSpatial, string Show, bool recordAllCells, double startTime);
     void addMultimeterLN(string multimeterID, string moduleID, int x, int y, double segment, double interval, double start, double stop, double rangePlot, string Show);
 
+    // The module at position pos (with the specified ID) is shown or recorded by a multimeter
+    bool isObserved(int pos, string ID);
+
     // Update displays
     void updateDisplay(CImg <double> *input, Retina &retina, int step, double totalSimTime, double numberTrials,double totalNumberTrials);
 
@@ -0,0 +1,52 @@
+#include "FastMath.h"
+
+#include <omp.h>
+
+// Clones of the array kernels for the vector instruction sets (the clone is selected
+// when the program is loaded)
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define FASTMATH_TARGETS __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define FASTMATH_TARGETS
+#endif
+
+// Minimum number of values to use several threads
+#define FASTMATH_PARALLEL_SIZE 16384
+
+FASTMATH_TARGETS
+static void expKernel(double *values, long n){
+    #pragma omp simd
+    for(long i=0;i<n;i++)
+        values[i] = FastMath::exp(values[i]);
+}
+
+FASTMATH_TARGETS
+static void powKernel(double *values, long n, double y){
+    FastMath::Power power(y);
+    #pragma omp simd
+    for(long i=0;i<n;i++)
+        values[i] = power(values[i]);
+}
+
+//------------------------------------------------------------------------------//
+
+// The array is divided in one contiguous block per thread, since the kernels cannot be
+// called from an omp for loop (the loop would not be compiled for the instruction set
+// of the clone)
+void FastMath::exp(double *values, long n){
+    #pragma omp parallel if(n >= FASTMATH_PARALLEL_SIZE)
+    {
+        long thread = omp_get_thread_num(), n_threads = omp_get_num_threads();
+        long first = n*thread/n_threads, last = n*(thread+1)/n_threads;
+        expKernel(values + first, last - first);
+    }
+}
+
+void FastMath::pow(double *values, long n, double y){
+    #pragma omp parallel if(n >= FASTMATH_PARALLEL_SIZE)
+    {
+        long thread = omp_get_thread_num(), n_threads = omp_get_num_threads();
+        long first = n*thread/n_threads, last = n*(thread+1)/n_threads;
+        powKernel(values + first, last - first, y);
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+/* BeginDocumentation
+ * Name: FastMath
+ *
+ * Description: polynomial approximations of exp, log, pow and the logistic function used by
+ * the nonlinear modules (StaticNonLinearity, ShortTermPlasticity and SingleCompartment) when
+ * the fast math mode is enabled (script command FastMath or argument -f of corem). The
+ * exp, pow and logistic have no branches or library calls, so the pixel loops that use them are
+ * vectorized. Powers with a constant exponent are computed with FastMath::Power. The array
+ * versions of exp and pow select at run time the widest vector instructions of the processor
+ * (AVX-512, AVX2 or SSE2 with GCC on x86-64).
+ * Maximum relative error (measured with 10^7 random arguments):
+ *   exp:      5.0e-16 for x in [-708,709] (results smaller than 2.2e-308 are flushed to 0)
+ *   log:      1.0e-15 for normal positive numbers (subnormal numbers are not supported)
+ *   pow:      7.5e-15 for |y*log(x)| < 15 (the error grows with |y*log(x)|); negative bases
+ *             follow std::pow for integer exponents and return NaN otherwise
+ * NaN, +-inf, zero and overflows give the same results as std::exp, std::log and std::pow.
+ *   logistic: 5.5e-16
+ * The modules keep the exact computation of the exponents special-cased by CImg::pow()
+ * (+-0.5 and the integers from -4 to 4).
+ * corem -V runs the retina script with and without fast math and reports the error of
+ * each module.
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ *
+ * SeeAlso: StaticNonLinearity, ShortTermPlasticity, SingleCompartment
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <limits>
+
+// The functions are always inlined so that they are compiled for the instruction set of
+// the loops that use them (see the array functions in FastMath.cpp)
+#ifdef __GNUC__
+#define FASTMATH_INLINE inline __attribute__((always_inline))
+#else
+#define FASTMATH_INLINE inline
+#endif
+
+class FastMath{
+protected:
+    static FASTMATH_INLINE double fromBits(uint64_t b){double d; memcpy(&d,&b,sizeof(d)); return d;}
+    static FASTMATH_INLINE uint64_t toBits(double d){uint64_t b; memcpy(&b,&d,sizeof(b)); return b;}
+
+    // log(x) for normal positive numbers: log(x) = k*ln2 + log(m), with m in [sqrt(2)/2, sqrt(2)),
+    // and log(m) = 2*atanh(s), s = (m-1)/(m+1) (odd series up to s^17)
+    static FASTMATH_INLINE double logPositive(double x){
+        const double ln2 = 0.69314718055994530942;
+        // k and m are obtained from the bits of x: subtracting the bits of sqrt(2)/2 leaves
+        // k in the exponent field (as a 12-bit two's complement number converted to double
+        // through the bits of 2^52 + k + 2048)
+        uint64_t tmp = toBits(x) - 0x3FE6A09E667F3BCDULL;
+        double k = fromBits((((tmp >> 52) & 0xFFF) ^ 0x800) | 0x4330000000000000ULL) - 4503599627370496.0 - 2048.0;
+        double m = fromBits(toBits(x) - (tmp & 0xFFF0000000000000ULL));
+
+        double s = (m - 1.0)/(m + 1.0);
+        double s2 = s*s;
+        double p = 1.0/17.0;
+        p = p*s2 + 1.0/15.0;
+        p = p*s2 + 1.0/13.0;
+        p = p*s2 + 1.0/11.0;
+        p = p*s2 + 1.0/9.0;
+        p = p*s2 + 1.0/7.0;
+        p = p*s2 + 1.0/5.0;
+        p = p*s2 + 1.0/3.0;
+        p = p*s2 + 1.0;
+        return k*ln2 + 2.0*s*p;
+    }
+
+public:
+    // exp(x) = 2^n * exp(r), with n = round(x/ln2) and |r| <= ln2/2 (Taylor polynomial of
+    // degree 12). n is obtained by adding 1.5*2^52 so that it is in the low mantissa bits.
+    // Out-of-range arguments are handled without comparisons (the conditional operator
+    // would prevent the vectorization of the loops): |x| is limited to 1000 with bit masks
+    // (NaN is kept), n is computed from x clamped to [-708,709] and r is clamped to [-1,1]
+    // (these clamps are approximate, but r is only modified by the rounding of r+-1 when
+    // |r| <= ln2/2). The results out of the range of normal numbers (including x = +-inf)
+    // are then replaced by +inf or 0 with the masks of x.
+    static FASTMATH_INLINE double exp(double x){
+        const double shifter = 6755399441055744.0; // 1.5*2^52
+        const double log2e = 1.4426950408889634;
+        const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+
+        uint64_t x_bits = toBits(x);
+        uint64_t magnitude_bits = x_bits & 0x7FFFFFFFFFFFFFFFULL;
+        uint64_t large_mask = 0 - ((0x408F400000000000ULL - magnitude_bits) >> 63); // |x| > 1000
+        uint64_t nan_mask = 0 - ((0x7FF0000000000000ULL - magnitude_bits) >> 63);
+        large_mask &= ~nan_mask;
+        uint64_t sign_mask = 0 - (x_bits >> 63);
+        uint64_t over_mask = ~sign_mask & ~nan_mask & (0 - ((0x40862E42FEFA39EFULL - x_bits) >> 63)); // x > log(DBL_MAX)
+        uint64_t under_mask = sign_mask & ~nan_mask & (0 - ((0x4086232BDD7ABCD2ULL - magnitude_bits) >> 63)); // x < log(DBL_MIN)
+        x = fromBits((x_bits & ~large_mask) | (((x_bits & 0x8000000000000000ULL) | 0x408F400000000000ULL) & large_mask));
+
+        double xc = 0.5*((x - 708.0) + fabs(x + 708.0)); // max(x,-708)
+        xc = 0.5*((xc + 709.0) - fabs(xc - 709.0)); // min(xc,709)
+        double kd = xc*log2e + shifter;
+        double n = kd - shifter;
+        double r = (x - n*ln2_hi) - n*ln2_lo;
+        r = 0.5*((r - 1.0) + fabs(r + 1.0)); // max(r,-1)
+        r = 0.5*((r + 1.0) - fabs(r - 1.0)); // min(r,1)
+
+        double p = 1.0/479001600.0;
+        p = p*r + 1.0/39916800.0;
+        p = p*r + 1.0/3628800.0;
+        p = p*r + 1.0/362880.0;
+        p = p*r + 1.0/40320.0;
+        p = p*r + 1.0/5040.0;
+        p = p*r + 1.0/720.0;
+        p = p*r + 1.0/120.0;
+        p = p*r + 1.0/24.0;
+        p = p*r + 1.0/6.0;
+        p = p*r + 0.5;
+        p = p*r + 1.0;
+        p = p*r + 1.0;
+
+        // 2^n (n between -1021 and 1023)
+        uint64_t value_bits = toBits(p*fromBits((toBits(kd) + 1023) << 52));
+        value_bits &= ~(over_mask | under_mask);
+        value_bits |= over_mask & 0x7FF0000000000000ULL;
+        return fromBits(value_bits);
+    }
+
+    static FASTMATH_INLINE double log(double x){
+        double value = logPositive(x);
+        value = (x == 0.0)? -std::numeric_limits<double>::infinity() : value;
+        value = (x < 0.0)? std::numeric_limits<double>::quiet_NaN() : value;
+        value = (x == std::numeric_limits<double>::infinity())? x : value;
+        value = (x != x)? x : value;
+        return value;
+    }
+
+    // x^y for a constant exponent y: the values that only depend on y are computed once
+    // (in the pixel loops the conditions on y would prevent the vectorization)
+    class Power{
+    protected:
+        double y;
+        // negative bases only have real powers for integer exponents (odd exponents change the
+        // sign), 0^y and inf^y are 0, 1 or inf and NaN^y is NaN (1 if y = 0)
+        uint64_t signBits, nanBits, zeroExponentMask;
+        double zeroValue, infValue;
+
+    public:
+        Power(double exponent){
+            y = exponent;
+            signBits = (y == floor(y) && 0.5*y != floor(0.5*y))? 0x8000000000000000ULL : 0;
+            nanBits = (y != floor(y))? 0x7FF8000000000000ULL : 0;
+            zeroExponentMask = (y == 0.0)? ~0ULL : 0;
+            zeroValue = (y > 0.0)? 0.0 : std::numeric_limits<double>::infinity();
+            zeroValue = (y == 0.0)? 1.0 : zeroValue;
+            infValue = (y > 0.0)? std::numeric_limits<double>::infinity() : 0.0;
+            infValue = (y == 0.0)? 1.0 : infValue;
+        }
+
+        FASTMATH_INLINE double operator()(double x) const{
+            double value = FastMath::exp(y*logPositive(fabs(x)));
+
+            // The special cases of x (negative, zero, +-inf or NaN) are applied with bit masks
+            // obtained from the bits of x (comparisons of x would also prevent the vectorization)
+            uint64_t x_bits = toBits(x);
+            uint64_t negative_mask = 0 - (x_bits >> 63);
+            uint64_t magnitude_bits = x_bits << 1;
+            uint64_t zero_mask = ((magnitude_bits | (0 - magnitude_bits)) >> 63) - 1;
+            uint64_t inf_bits = magnitude_bits ^ 0xFFE0000000000000ULL;
+            uint64_t inf_mask = ((inf_bits | (0 - inf_bits)) >> 63) - 1;
+            uint64_t nan_mask = 0 - ((0x7FF0000000000000ULL - (x_bits & 0x7FFFFFFFFFFFFFFFULL)) >> 63);
+
+            uint64_t value_bits = toBits(value);
+            value_bits |= negative_mask & nanBits;
+            value_bits = (value_bits & ~zero_mask) | (toBits(zeroValue) & zero_mask);
+            value_bits = (value_bits & ~inf_mask) | (toBits(infValue) & inf_mask);
+            value_bits ^= negative_mask & signBits;
+            uint64_t nan_value_bits = (x_bits & ~zeroExponentMask) | (0x3FF0000000000000ULL & zeroExponentMask);
+            value_bits = (value_bits & ~nan_mask) | (nan_value_bits & nan_mask);
+            return fromBits(value_bits);
+        }
+    };
+
+    // Exponents that CImg::pow() computes with products, divisions or square roots (exact
+    // and faster than the approximation), which the modules keep using
+    static FASTMATH_INLINE bool isExactExponent(double y){
+        return(y == 0.0 || y == 0.5 || y == 1.0 || y == 2.0 || y == 3.0 || y == 4.0 ||
+               y == -0.5 || y == -1.0 || y == -2.0 || y == -3.0 || y == -4.0);
+    }
+
+    // x^y
+    static FASTMATH_INLINE double pow(double x, double y){
+        return Power(y)(x);
+    }
+
+    // 1/(1+exp(-x))
+    static FASTMATH_INLINE double logistic(double x){
+        return 1.0/(1.0 + FastMath::exp(-x));
+    }
+
+    // In-place evaluation over arrays: vectorized for the instruction set of the processor
+    // and multithreaded for large arrays
+    static void exp(double *values, long n);
+    static void pow(double *values, long n, double y);
+};
+
+#endif // FASTMATH_H
@@ -5,17 +5,20 @@
 #include "FileReader.h"
 #include "SequenceInput.h"
 #include "StreamingInput.h"
+#include "BufferInput.h"
 
 FileReader::FileReader(int X, int Y, double tstep){
     CorrectFile = true;
     continueReading = true;
     fileName = "";
+    readFromString = false;
 }
 
 void FileReader::reset(int X, int Y, double tstep){
     CorrectFile = true;
     continueReading = true;
     fileName = "";
+    readFromString = false;
 }
 
 FileReader::FileReader(const FileReader& copy){
@@ -31,12 +34,24 @@ FileReader::~FileReader(void){
 
 void FileReader::setDir(const char *s){
     fileName = s;
+    readFromString = false;
+}
+
+void FileReader::setScript(const string &script_text){
+    fileName = "(script text)";
+    scriptStream.clear();
+    scriptStream.str(script_text);
+    readFromString = true;
 }
 
 //-------------------------------------------------//
 
 bool FileReader::allocateValues(){
     bool ret_correct;
+
+    if(readFromString) // Nothing to open
+        return(true);
+
     fin.open(fileName);
 
     if (!fin.good()) {
@@ -292,15 +307,16 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
     bool verbose = false;
     int line = 0;
     int action = 0;
+    istream &script = (readFromString)? static_cast<istream&>(scriptStream) : static_cast<istream&>(fin);
 
-    while (!fin.eof() && CorrectFile && continueReading){
+    while (!script.eof() && CorrectFile && continueReading){
         // read a line into memory
         char line_buf[MAX_CHARS_PER_LINE];
         // array to store memory addresses of the tokens in line_buf
         char *token[MAX_TOKENS_PER_LINE];
         
         line++;
-        fin.getline(line_buf, MAX_CHARS_PER_LINE); // Endline char not included
+        script.getline(line_buf, MAX_CHARS_PER_LINE); // Endline char not included
 
         if(parseLine(line_buf, token, MAX_TOKENS_PER_LINE))
             discardTokens(token, "'(),"); // These tokens are not meaningfull for the script syntax
@@ -331,6 +347,18 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                         else if( strcmp(token[1], "DisplayWindows") == 0 ){
                             action = 7;
                         }
+                        else if( strcmp(token[1], "DisplayRefreshRate") == 0 ){
+                            action = 17;
+                        }
+                        else if( strcmp(token[1], "RandomSeed") == 0 ){
+                            action = 18;
+                        }
+                        else if( strcmp(token[1], "FastMath") == 0 ){
+                            action = 19;
+                        }
+                        else if( strcmp(token[1], "BatchSize") == 0 ){
+                            action = 20;
+                        }
                         else if( strcmp(token[1], "Input") == 0 ){
                             action = 8;
                         }
@@ -456,8 +484,44 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                             }
                             // Add module to the retina
                             if(continueReading){
-                                int err_param_num = newModule->setParameters(p,pid);
+                                // The update period, the interpolation of the output and the downsampling factor are
+                                // set by the module class (see module::setUpdatePeriod()) before the parameters which
+                                // depend on the step or on the pixel size
+                                vector<double> module_p;
+                                vector<string> module_pid;
+                                vector<int> param_num; // Number of each module parameter in the script
+                                int err_param_num = 0;
+
+                                for(size_t k=0;k<pid.size() && err_param_num == 0;k++){
+                                    if(pid[k] == "updateEvery"){
+                                        if(p[k] != floor(p[k]) || !newModule->setUpdatePeriod((int)p[k]))
+                                            err_param_num = -(int)(k+1);
+                                    }else if(pid[k] == "downsample"){
+                                        if(p[k] != floor(p[k]) || !newModule->setDownsample((int)p[k]))
+                                            err_param_num = -(int)(k+1);
+                                    }else if(pid[k] == "interpolate"){
+                                        newModule->setInterpolateOutput(p[k] != 0.0);
+                                    }else{
+                                        module_p.push_back(p[k]);
+                                        module_pid.push_back(pid[k]);
+                                        param_num.push_back((int)(k+1));
+                                    }
+                                }
+                                if(err_param_num == 0){
+                                    err_param_num = newModule->setParameters(module_p,module_pid);
+                                    if(err_param_num != 0 && abs(err_param_num) <= (int)param_num.size())
+                                        err_param_num = (err_param_num > 0)? param_num[err_param_num-1] : -param_num[-err_param_num-1];
+                                }
                                 if(err_param_num == 0){
+                                    // Modules created with the same type, parameters, step and ppd compute the
+                                    // same output from the same inputs (see Retina::mergeDuplicateModules())
+                                    ostringstream signature;
+                                    signature.precision(17);
+                                    signature << token[2] << " step=" << retina.getStep() << " ppd=" << retina.getPixelsPerDegree();
+                                    for(size_t k=0;k<pid.size();k++)
+                                        signature << " " << pid[k] << "=" << p[k];
+                                    newModule->setSignature(signature.str());
+
                                     retina.addModule(newModule,token[3]);
                                 }else{
                                     abort(line,"Error setting specified module parameters (incorrect %s of parameter number %i)", (err_param_num>0)?"name":"value", abs(err_param_num));
@@ -640,6 +704,84 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                 action = 0;
                 break;
 
+            // Maximum display refresh rate
+            case 17:
+
+                if (token[2]){
+                    if (atof(token[2])>=0)
+                        displayMg.setRefreshRate(atof(token[2]));
+                    else{
+                        abort(line,"Expected positive or zero value (>=0)");
+                        break;
+                    }
+                }else{
+                    abort(line,"Expected maximum number of frames per second");
+                    break;
+                }
+
+                if(verbose)cout << "Display refresh rate = "<< atof(token[2]) << endl;
+                action = 0;
+                break;
+
+            // Seed of the random streams of all stochastic inputs and modules
+            case 18:
+
+                if (token[2]){
+                    if (atof(token[2])>=0)
+                        CounterRNG::setSeed((uint64_t)atof(token[2]));
+                    else{
+                        abort(line,"Expected positive or zero value (>=0)");
+                        break;
+                    }
+                }else{
+                    abort(line,"Expected random seed");
+                    break;
+                }
+
+                if(verbose)cout << "Random seed = "<< CounterRNG::getSeed() << endl;
+                action = 0;
+                break;
+
+            // Fast math approximations of the nonlinear modules (see FastMath)
+            case 19:
+
+                if (token[2]){
+                    if(strcmp(token[2],"True")==0)
+                        retina.setFastMath(true);
+                    else if(strcmp(token[2],"False")==0)
+                        retina.setFastMath(false);
+                    else{
+                        abort(line,"Expected 'True' or 'False' value for FastMath");
+                        break;
+                    }
+                }else{
+                    abort(line,"Expected 'True' or 'False' value for FastMath");
+                    break;
+                }
+
+                if(verbose)cout << "Fast math = "<< token[2] << endl;
+                action = 0;
+                break;
+
+            // Number of stimuli simulated in one pass (see Retina::setBatchSize())
+            case 20:
+
+                if (token[2]){
+                    if (atof(token[2])>=1 && atof(token[2]) == floor(atof(token[2])))
+                        retina.setBatchSize((int)atof(token[2]));
+                    else{
+                        abort(line,"Expected positive integer value (>0)");
+                        break;
+                    }
+                }else{
+                    abort(line,"Expected batch size");
+                    break;
+                }
+
+                if(verbose)cout << "Batch size = "<< retina.getBatchSize() << endl;
+                action = 0;
+                break;
+
             // Input
             case 8:
                 if (token[2] && token[3]){
@@ -663,11 +805,36 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                             break;
                         }
                     }else if(strcmp(token[2], "whiteNoise") == 0 ){
-                        if (strcmp(token[3], "{") == 0 && strcmp(token[4],"mean")==0 && strcmp(token[6],"contrast1")==0 && strcmp(token[8],"contrast2")==0 && strcmp(token[10],"period")==0 && strcmp(token[12],"switch")==0 && strcmp(token[14],"sizeX")==0 && strcmp(token[16],"sizeY")==0 && strcmp(token[18],"}")==0){
+                        if (strcmp(token[3], "{") == 0 && strcmp(token[4],"mean")==0 && strcmp(token[6],"contrast1")==0 && strcmp(token[8],"contrast2")==0 && strcmp(token[10],"period")==0 && strcmp(token[12],"switch")==0 && strcmp(token[14],"sizeX")==0 && strcmp(token[16],"sizeY")==0 && token[18]){
                             continueReading=retina.generateWhiteNoise(atof(token[5]),atof(token[7]),atof(token[9]),atof(token[11]),atof(token[13]),atof(token[15]),atof(token[17]));
+
+                            // Optional parameters of spatiotemporal noise
+                            int next_tok_idx=18;
+                            while(continueReading && token[next_tok_idx] && strcmp(token[next_tok_idx],"}")!=0){
+                                if(!token[next_tok_idx+1]){
+                                    abort(line,"Expected value of whiteNoise parameter");
+                                    break;
+                                }
+                                if(strcmp(token[next_tok_idx],"checkerSize")==0){
+                                    if(!retina.getWhiteNoise()->setCheckerSize(atoi(token[next_tok_idx+1]))){
+                                        abort(line,"Expected positive or zero checker size (>=0)");
+                                        break;
+                                    }
+                                }else if(strcmp(token[next_tok_idx],"binary")==0){
+                                    retina.getWhiteNoise()->setBinary(atof(token[next_tok_idx+1]) != 0.0);
+                                }else{
+                                    abort(line,"Unknown whiteNoise parameter. Optional parameters: 'checkerSize','binary'");
+                                    break;
+                                }
+                                next_tok_idx+=2;
+                            }
+                            if(continueReading && !token[next_tok_idx]){
+                                abort(line,"Expected '}' at the end of the whiteNoise parameter list");
+                                break;
+                            }
                             if(verbose)cout << "White noise generated." << endl;
                         }else{
-                            abort(line,"Expected parameter list of whiteNoise: 'mean','contrast1','contrast2','period','switch','sizeX','sizeY'");
+                            abort(line,"Expected parameter list of whiteNoise: 'mean','contrast1','contrast2','period','switch','sizeX','sizeY' (optional: 'checkerSize','binary')");
                             break;
                         }
                     }else if(strcmp(token[2], "impulse") == 0 ){
@@ -691,6 +858,19 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                             if(verbose) cout << "Input configured as sequence of frames." << endl;
                         } else 
                             break;
+                    }else if(strcmp(token[2], "buffer") == 0 ){
+                        module *new_input_module;
+                        new_input_module = new BufferInput(retina.getSizeX(), retina.getSizeY(), retina.getStep());
+
+                        parseParameterBlock(token+3, new_input_module, line);
+
+                        // Add module to the retina
+                        if(continueReading) {
+                            retina.addModule(new_input_module, "Input");
+                            retina.setModuleInput();
+                            if(verbose) cout << "Input configured as external frame buffer." << endl;
+                        } else
+                            break;
                     }else if(strcmp(token[2], "streaming") == 0 ){
                         module *new_input_module;
                         new_input_module = new StreamingInput(retina.getSizeX(), retina.getSizeY(), retina.getStep(), token[3]);
@@ -987,6 +1167,18 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
                                 next_tok_idx=4; // continue reading parameters from this current token
                             }
                             newModule = new SequenceOutput(retina.getSizeX(), retina.getSizeY(), retina.getStep(), output_filename);
+                        }
+                        else if (strcmp(token[2], "monitor") == 0 ) {
+                            string connection_url;
+
+                            if (token[4] && strcmp(token[4], "{") != 0){ // the next token is not {, assume that it is the socket URL
+                                connection_url=token[4]; // Replace (default) URL
+                                next_tok_idx=5; // Pass to the next token to continue reading parameters
+                            } else {
+                                connection_url=""; // Use the default URL
+                                next_tok_idx=4; // continue reading parameters from this current token
+                            }
+                            newModule = new MonitorOutput(retina.getSizeX(), retina.getSizeY(), retina.getStep(), connection_url);
                         } else {
                             abort(line,"Unknown retina output type");
                             break;
@@ -1019,8 +1211,13 @@ void FileReader::parseFile(Retina &retina, DisplayManager &displayMg){
         }
     }//end while
 
+    // Modules which compute the same output as other module are replaced with aliases of it
+    if(continueReading && CorrectFile)
+        retina.mergeDuplicateModules();
+
     // close file
-    fin.close();
+    if(!readFromString)
+        fin.close();
 }
 
 //-------------------------------------------------//
@@ -15,6 +15,9 @@
 #include "DisplayManager.h"
 #include "StaticNonLinearity.h"
 #include "ShortTermPlasticity.h"
+#include "CounterRNG.h"
+
+#include <sstream>
 
 using namespace cimg_library;
 using namespace std;
@@ -38,6 +41,9 @@ private:
     // File reader
     const char* fileName;
     ifstream fin;
+    // Script text (used instead of the file if it is set with setScript())
+    istringstream scriptStream;
+    bool readFromString;
 
 public:
 
@@ -50,6 +56,8 @@ public:
     void reset(int X, int Y, double tstep);
     //set directory
     void setDir(const char* s);
+    // set the text of the retina script (parsed instead of a file)
+    void setScript(const string &script_text);
     // allocate values
     bool allocateValues();
 
@@ -1,5 +1,8 @@
 #include "GaussFilter.h"
 #include <iostream>
+
+vector<GaussFilter::SpaceVariantCoefficients*> GaussFilter::coefficientCache;
+
 GaussFilter::GaussFilter(int x, int y, double ppd):module(x,y,1.0){
     pixelsPerDegree = ppd;
     // *GaussVertical and *GaussHorizontal functions need at least 3 coords in sizeX and sizeY dim.
@@ -21,6 +24,11 @@ GaussFilter::GaussFilter(int x, int y, double ppd):module(x,y,1.0){
     spaceVariantSigma = true;
     K = 0.2;
     R0 = 5.0;
+    svCoefficients = NULL;
+    MRThreshold = 16.0;
+    MRSigma = 4.0;
+    decimationFactor = 1;
+    reducedFilter = NULL;
 }
 
 GaussFilter::GaussFilter(const GaussFilter &copy):module(copy){
@@ -30,17 +38,24 @@ GaussFilter::GaussFilter(const GaussFilter &copy):module(copy){
     spaceVariantSigma = copy.spaceVariantSigma;
     K = copy.K;
     R0 = copy.R0;
+    MRThreshold = copy.MRThreshold;
+    MRSigma = copy.MRSigma;
     buffSizeX = copy.buffSizeX;
     buffSizeY = copy.buffSizeY;
 
     inputImage = new CImg<double>(*(copy.inputImage));
     outputImage = new CImg<double>(*(copy.outputImage));
     buffer = new double[(buffSizeX+buffSizeY)*omp_get_max_threads()];
-    
+    svCoefficients = NULL;
+    decimationFactor = 1;
+    reducedFilter = NULL;
+
     allocateValues();
 }
 
 GaussFilter::~GaussFilter(){
+    releaseCoefficients(svCoefficients);
+    delete reducedFilter;
 
     delete[] buffer;
     delete outputImage;
@@ -61,13 +76,32 @@ bool GaussFilter::allocateValues(){
     // transform sigma to pixels
     sigma*=pixelsPerDegree;
     // Resize images
-    inputImage->assign(buffSizeY, buffSizeX, 1, 1, 0.1);
-    outputImage->assign(sizeY, sizeX, 1, 1, 0.1);
+    inputImage->assign(buffSizeY, buffSizeX, batchSize, 1, 0.1);
+    outputImage->assign(sizeY, sizeX, batchSize, 1, 0.1);
 
     // reallocate space for all possible threads
     delete[] buffer;
     buffer = new double[(buffSizeX+buffSizeY)*omp_get_max_threads()];
 
+    // the filter may have been allocated with other parameters
+    releaseCoefficients(svCoefficients);
+    svCoefficients = NULL;
+    delete reducedFilter;
+    reducedFilter = NULL;
+    decimationFactor = 1;
+
+    // large sigmas are filtered at reduced resolution (the reduced grid must have at least
+    // 3 pixels in each dimension)
+    if(MRThreshold > 0.0 && sigma > MRThreshold){
+        int factor = max(2, (int)(sigma/MRSigma));
+        factor = min(factor, min(sizeX,sizeY)/3);
+        if(factor >= 2){
+            decimationFactor = factor;
+            allocateReducedFilter();
+            return(true);
+        }
+    }
+
     if (spaceVariantSigma==false){
 
         // coefficient calculation
@@ -86,76 +120,204 @@ bool GaussFilter::allocateValues(){
         b2 /= b0;
         b3 /= b0;
 
-        // From: Bill Triggs, Michael Sdika: Boundary Conditions for Young-van Vliet Recursive Filtering
-        M[0][0] = -b3*b1+1.0-b3*b3-b2;
-        M[0][1] = (b3+b1)*(b2+b3*b1);
-        M[0][2] = b3*(b1+b3*b2);
-        M[1][0] = b1+b3*b2;
-        M[1][1] = -(b2-1.0)*(b2+b3*b1);
-        M[1][2] = -(b3*b1+b3*b3+b2-1.0)*b3;
-        M[2][0] = b3*b1+b2+b1*b1-b2*b2;
-        M[2][1] = b1*b2+b3*b2*b2-b1*b3*b3-b3*b3*b3-b3*b2+b3;
-        M[2][2] = b3*(b1+b3*b2);
-        for (int i=0; i<3; i++)
-            for (int j=0; j<3; j++)
-                M[i][j] /= (1.0+b1-b2+b3)*(1.0+b2+(b1-b3)*b3);
+        boundaryMatrix(b1, b2, b3, &M[0][0]);
 
     }else{
+        svCoefficients = acquireCoefficients();
+    }
 
+    return(true);
+}
 
-        double new_sigma = 0.0;
-        double r;
-        //double rmax;
+//------------------------------------------------------------------------------//
 
-        // initialize matrices
-        q_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        b0_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        b1_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        b2_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        b3_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        B_m.assign(sizeY, sizeX, 1, 1, 0.1);
-        M_m.assign(sizeY, sizeX, 9, 1, 0.1);
+// From: Bill Triggs, Michael Sdika: Boundary Conditions for Young-van Vliet Recursive Filtering
+void GaussFilter::boundaryMatrix(double b1, double b2, double b3, double *m){
+    m[0] = -b3*b1+1.0-b3*b3-b2;
+    m[1] = (b3+b1)*(b2+b3*b1);
+    m[2] = b3*(b1+b3*b2);
+    m[3] = b1+b3*b2;
+    m[4] = -(b2-1.0)*(b2+b3*b1);
+    m[5] = -(b3*b1+b3*b3+b2-1.0)*b3;
+    m[6] = b3*b1+b2+b1*b1-b2*b2;
+    m[7] = b1*b2+b3*b2*b2-b1*b3*b3-b3*b3*b3-b3*b2+b3;
+    m[8] = b3*(b1+b3*b2);
+    for (int z=0; z<9; z++)
+        m[z] /= (1.0+b1-b2+b3)*(1.0+b2+(b1-b3)*b3);
+}
+
+//------------------------------------------------------------------------------//
+
+GaussFilter::SpaceVariantCoefficients* GaussFilter::acquireCoefficients(){
+    SpaceVariantCoefficients *coefs = NULL;
+
+    // The retinas of different NEST nodes may be allocated concurrently
+    #pragma omp critical(GaussFilterCoefficients)
+    {
+        for(size_t k=0;k<coefficientCache.size() && coefs==NULL;k++){
+            SpaceVariantCoefficients *cached = coefficientCache[k];
+            if(cached->sizeX==sizeX && cached->sizeY==sizeY && cached->sigma==sigma && cached->K==K &&
+               cached->R0==R0 && cached->pixelsPerDegree==pixelsPerDegree)
+                coefs = cached;
+        }
+
+        if(coefs==NULL){
+            coefs = new SpaceVariantCoefficients;
+            coefs->sizeX = sizeX;
+            coefs->sizeY = sizeY;
+            coefs->sigma = sigma;
+            coefs->K = K;
+            coefs->R0 = R0;
+            coefs->pixelsPerDegree = pixelsPerDegree;
+            coefs->users = 0;
+            computeCoefficients(*coefs);
+            coefficientCache.push_back(coefs);
+        }
+        coefs->users++;
+    }
+    return coefs;
+}
 
+void GaussFilter::releaseCoefficients(SpaceVariantCoefficients *coefs){
+    if(coefs==NULL)
+        return;
+
+    #pragma omp critical(GaussFilterCoefficients)
+    {
+        coefs->users--;
+        if(coefs->users==0){
+            coefficientCache.erase(find(coefficientCache.begin(), coefficientCache.end(), coefs));
+            delete coefs;
+        }
+    }
+}
+
+void GaussFilter::computeCoefficients(SpaceVariantCoefficients &coefs){
+    coefs.coefficients.assign(4*(size_t)buffSizeX*buffSizeY, 0.1);
+    coefs.rowM.assign(9*buffSizeX, 0.1);
+    coefs.columnM.assign(9*buffSizeY, 0.1);
+
+    #pragma omp parallel for
+    for(int j=0;j<sizeX;j++){
         for(int i=0;i<sizeY;i++){
-            for(int j=0;j<sizeX;j++){
-
-                // update sigma value
-                r = sqrt((double(i)-floor(sizeY/2))*(double(i)-floor(sizeY/2)) + (double(j)-floor(sizeX/2))*(double(j)-floor(sizeX/2)));          
-                new_sigma = sigma / density(r/pixelsPerDegree);
-
-                // coefficient calculation
-                q_m(i,j,0) = 0.98711 * new_sigma - 0.96330;
-
-                if (new_sigma<2.5)
-                    q_m(i,j,0) = 3.97156 - 4.14554 * sqrt (1.0 - 0.26891 * new_sigma);
-
-                b0_m(i,j,0) = 1.57825 + 2.44413*q_m(i,j,0) + 1.4281*q_m(i,j,0)*q_m(i,j,0) + 0.422205*q_m(i,j,0)*q_m(i,j,0)*q_m(i,j,0);
-                b1_m(i,j,0) = 2.44413*q_m(i,j,0) + 2.85619*q_m(i,j,0)*q_m(i,j,0) + 1.26661*q_m(i,j,0)*q_m(i,j,0)*q_m(i,j,0);
-                b2_m(i,j,0) = -1.4281*q_m(i,j,0)*q_m(i,j,0) - 1.26661*q_m(i,j,0)*q_m(i,j,0)*q_m(i,j,0);
-                b3_m (i,j,0)= 0.422205*q_m(i,j,0)*q_m(i,j,0)*q_m(i,j,0);
-                B_m(i,j,0) = 1.0 - (b1_m(i,j,0)+b2_m(i,j,0)+b3_m(i,j,0)) / b0_m(i,j,0);
-
-                b1_m(i,j,0) /= b0_m(i,j,0);
-                b2_m(i,j,0) /= b0_m(i,j,0);
-                b3_m(i,j,0) /= b0_m(i,j,0);
-
-                // From: Bill Triggs, Michael Sdika: Boundary Conditions for Young-van Vliet Recursive Filtering
-                M_m(i,j,0) = -b3_m(i,j,0)*b1_m(i,j,0)+1.0-b3_m(i,j,0)*b3_m(i,j,0)-b2_m(i,j,0);
-                M_m(i,j,1) = (b3_m(i,j,0)+b1_m(i,j,0))*(b2_m(i,j,0)+b3_m(i,j,0)*b1_m(i,j,0));
-                M_m(i,j,2) = b3_m(i,j,0)*(b1_m(i,j,0)+b3_m(i,j,0)*b2_m(i,j,0));
-                M_m(i,j,3) = b1_m(i,j,0)+b3_m(i,j,0)*b2_m(i,j,0);
-                M_m(i,j,4) = -(b2_m(i,j,0)-1.0)*(b2_m(i,j,0)+b3_m(i,j,0)*b1_m(i,j,0));
-                M_m(i,j,5) = -(b3_m(i,j,0)*b1_m(i,j,0)+b3_m(i,j,0)*b3_m(i,j,0)+b2_m(i,j,0)-1.0)*b3_m(i,j,0);
-                M_m(i,j,6) = b3_m(i,j,0)*b1_m(i,j,0)+b2_m(i,j,0)+b1_m(i,j,0)*b1_m(i,j,0)-b2_m(i,j,0)*b2_m(i,j,0);
-                M_m(i,j,7) = b1_m(i,j,0)*b2_m(i,j,0)+b3_m(i,j,0)*b2_m(i,j,0)*b2_m(i,j,0)-b1_m(i,j,0)*b3_m(i,j,0)*b3_m(i,j,0)-b3_m(i,j,0)*b3_m(i,j,0)*b3_m(i,j,0)-b3_m(i,j,0)*b2_m(i,j,0)+b3_m(i,j,0);
-                M_m(i,j,8) = b3_m(i,j,0)*(b1_m(i,j,0)+b3_m(i,j,0)*b2_m(i,j,0));
-                for (int z=0; z<9; z++)
-                    M_m(i,j,z) /= (1.0+b1_m(i,j,0)-b2_m(i,j,0)+b3_m(i,j,0))*(1.0+b2_m(i,j,0)+(b1_m(i,j,0)-b3_m(i,j,0))*b3_m(i,j,0));
+
+            // update sigma value
+            double r = sqrt((double(i)-floor(sizeY/2))*(double(i)-floor(sizeY/2)) + (double(j)-floor(sizeX/2))*(double(j)-floor(sizeX/2)));
+            double new_sigma = sigma / density(r/pixelsPerDegree);
+
+            // coefficient calculation
+            double q_p = 0.98711 * new_sigma - 0.96330;
+
+            if (new_sigma<2.5)
+                q_p = 3.97156 - 4.14554 * sqrt (1.0 - 0.26891 * new_sigma);
+
+            double b0_p = 1.57825 + 2.44413*q_p + 1.4281*q_p*q_p + 0.422205*q_p*q_p*q_p;
+            double b1_p = 2.44413*q_p + 2.85619*q_p*q_p + 1.26661*q_p*q_p*q_p;
+            double b2_p = -1.4281*q_p*q_p - 1.26661*q_p*q_p*q_p;
+            double b3_p = 0.422205*q_p*q_p*q_p;
+            double B_p = 1.0 - (b1_p+b2_p+b3_p) / b0_p;
+
+            b1_p /= b0_p;
+            b2_p /= b0_p;
+            b3_p /= b0_p;
+
+            double *c = &coefs.coefficients[4*((size_t)j*buffSizeY+i)];
+            c[0] = B_p;
+            c[1] = b1_p;
+            c[2] = b2_p;
+            c[3] = b3_p;
+
+            // the boundary matrices are only used where the recursions start
+            if(i==0)
+                boundaryMatrix(b1_p, b2_p, b3_p, &coefs.rowM[9*j]);
+            if(j==0)
+                boundaryMatrix(b1_p, b2_p, b3_p, &coefs.columnM[9*i]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+void GaussFilter::allocateReducedFilter(){
+    const int f = decimationFactor;
+    // margin of the reduced grid (in reduced pixels)
+    const int pad = (int)ceil(3.0*sigma/f);
+    const int reduced_x = (sizeX + f - 1)/f + 2*pad, reduced_y = (sizeY + f - 1)/f + 2*pad;
+
+    // The average of blocks of fxf pixels is a box filter with variance (f^2-1)/12 in each
+    // dimension, which is subtracted from the variance of the reduced filter. The reduced
+    // sigma is given in degrees (the reduced filter transforms it to pixels)
+    reducedFilter = new GaussFilter(reduced_x, reduced_y, pixelsPerDegree/f);
+    reducedFilter->sigma = sqrt(max(sigma*sigma - (f*f - 1.0)/12.0, 0.0))/pixelsPerDegree;
+    reducedFilter->spaceVariantSigma = spaceVariantSigma;
+    reducedFilter->K = K;
+    reducedFilter->R0 = R0;
+    reducedFilter->MRThreshold = 0.0;
+    reducedFilter->batchSize = batchSize;
+    reducedFilter->allocateValues();
+
+    // The reduced pixel k averages the block of pixels [(k-pad)*f, (k-pad+1)*f-1]
+    decimateColumn.resize(reduced_y*f);
+    for(int i=0;i<reduced_y*f;i++)
+        decimateColumn[i] = min(max(i - pad*f, 0), sizeY - 1);
+    decimateRow.resize(reduced_x*f);
+    for(int j=0;j<reduced_x*f;j++)
+        decimateRow[j] = min(max(j - pad*f, 0), sizeX - 1);
+
+    // Bilinear interpolation between the centers of the blocks
+    upsampleColumn.resize(sizeY);
+    upsampleColumnWeight.resize(sizeY);
+    for(int i=0;i<sizeY;i++){
+        double u = min(max((i - 0.5*(f - 1))/f + pad, 0.0), reduced_y - 1.0);
+        upsampleColumn[i] = min((int)u, reduced_y - 2);
+        upsampleColumnWeight[i] = u - upsampleColumn[i];
+    }
+    upsampleRow.resize(sizeX);
+    upsampleRowWeight.resize(sizeX);
+    for(int j=0;j<sizeX;j++){
+        double v = min(max((j - 0.5*(f - 1))/f + pad, 0.0), reduced_x - 1.0);
+        upsampleRow[j] = min((int)v, reduced_x - 2);
+        upsampleRowWeight[j] = v - upsampleRow[j];
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+void GaussFilter::decimate(const CImg<double> &src, CImg<double> &reduced){
+    const int f = decimationFactor;
+    const int reduced_x = reducedFilter->sizeX, reduced_y = reducedFilter->sizeY;
+    const double norm = 1.0/(f*f);
+
+#pragma omp parallel for
+    for(long k=0;k<(long)reduced_x*src.depth();k++){
+        const int J = (int)(k % reduced_x), z = (int)(k / reduced_x);
+        for(int I=0;I<reduced_y;I++){
+            double sum = 0.0;
+            for(int b=0;b<f;b++){
+                const int j = decimateRow[J*f + b];
+                for(int a=0;a<f;a++)
+                    sum += src(decimateColumn[I*f + a],j,z);
             }
+            reduced(I,J,z) = sum*norm;
         }
     }
+}
 
-    return(true);
+void GaussFilter::upsample(const CImg<double> &reduced, CImg<double> &dst){
+
+#pragma omp parallel for
+    for(long k=0;k<(long)sizeX*dst.depth();k++){
+        const int j = (int)(k % sizeX), z = (int)(k / sizeX);
+        const int J = upsampleRow[j];
+        const double wy = upsampleRowWeight[j];
+        for(int i=0;i<sizeY;i++){
+            const int I = upsampleColumn[i];
+            const double wx = upsampleColumnWeight[i];
+            double top = reduced(I,J,z) + wx*(reduced(I+1,J,z) - reduced(I,J,z));
+            double bottom = reduced(I,J+1,z) + wx*(reduced(I+1,J+1,z) - reduced(I,J+1,z));
+            dst(i,j,z) = top + wy*(bottom - top);
+        }
+    }
 }
 
 //------------------------------------------------------------------------------//
@@ -170,6 +332,37 @@ bool GaussFilter::setSigma(double sigm){
     return(ret_correct);
 }
 
+bool GaussFilter::setMRThreshold(double threshold){
+    bool ret_correct;
+    if (threshold>= 0){
+        MRThreshold = threshold;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool GaussFilter::setMRSigma(double reduced_sigma){
+    bool ret_correct;
+    if (reduced_sigma> 0){
+        MRSigma = reduced_sigma;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool GaussFilter::setDownsample(int factor){
+    bool ret_correct;
+    int previous_factor = downsample;
+    if (module::setDownsample(factor)){
+        pixelsPerDegree = pixelsPerDegree*previous_factor/factor;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
 //------------------------------------------------------------------------------//
 
 
@@ -177,20 +370,21 @@ void GaussFilter::gaussVertical(CImg<double> &src){
 
 #pragma omp parallel for
 
-    for (int i=0; i<sizeY; i++) {
+    for (long k=0; k<(long)sizeY*src.depth(); k++) {
+        const int i = (int)(k % sizeY), z = (int)(k / sizeY);
 
         double* temp2 = buffer + omp_get_thread_num()*(buffSizeX+buffSizeY);
 
-        temp2[0] = B*(double)src(i,0,0) + b1*(double)src(i,0,0) + b2*(double)src(i,0,0) + b3*(double)src(i,0,0);
-        temp2[1] = B*(double)src(i,1,0) + b1*temp2[0]  + b2*(double)src(i,0,0) + b3*(double)src(i,0,0);
-        temp2[2] = B*(double)src(i,2,0) + b1*temp2[1]  + b2*temp2[0]  + b3*(double)src(i,0,0);
+        temp2[0] = B*(double)src(i,0,z) + b1*(double)src(i,0,z) + b2*(double)src(i,0,z) + b3*(double)src(i,0,z);
+        temp2[1] = B*(double)src(i,1,z) + b1*temp2[0]  + b2*(double)src(i,0,z) + b3*(double)src(i,0,z);
+        temp2[2] = B*(double)src(i,2,z) + b1*temp2[1]  + b2*temp2[0]  + b3*(double)src(i,0,z);
 
         for (int j=3; j<buffSizeX; j++)
-            temp2[j] = B*(double)src(i,j,0) + b1*temp2[j-1] + b2*temp2[j-2] + b3*temp2[j-3];
+            temp2[j] = B*(double)src(i,j,z) + b1*temp2[j-1] + b2*temp2[j-2] + b3*temp2[j-3];
 
-        double temp2Wm1 = (double)src(i,buffSizeX-1,0) + M[0][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M[0][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M[0][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
-        double temp2W   = (double)src(i,buffSizeX-1,0) + M[1][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M[1][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M[1][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
-        double temp2Wp1 = (double)src(i,buffSizeX-1,0) + M[2][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M[2][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M[2][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
+        double temp2Wm1 = (double)src(i,buffSizeX-1,z) + M[0][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + M[0][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + M[0][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
+        double temp2W   = (double)src(i,buffSizeX-1,z) + M[1][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + M[1][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + M[1][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
+        double temp2Wp1 = (double)src(i,buffSizeX-1,z) + M[2][0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + M[2][1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + M[2][2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
 
         temp2[buffSizeX-1] = temp2Wm1;
         temp2[buffSizeX-2] = B * temp2[buffSizeX-2] + b1*temp2[buffSizeX-1] + b2*temp2W + b3*temp2Wp1;
@@ -199,7 +393,7 @@ void GaussFilter::gaussVertical(CImg<double> &src){
         for (int j=buffSizeX-4; j>=0; j--)
             temp2[j] = B * temp2[j] + b1*temp2[j+1] + b2*temp2[j+2] + b3*temp2[j+3];
         for (int j=0; j<buffSizeX; j++)
-            src(i,j,0) = (double)temp2[j];
+            src(i,j,z) = (double)temp2[j];
     }
 }
 
@@ -209,20 +403,21 @@ void GaussFilter::gaussHorizontal(CImg<double> &src){
 
 #pragma omp parallel for
 
-    for (int i=0; i<sizeX; i++) {
+    for (long k=0; k<(long)sizeX*src.depth(); k++) {
+        const int i = (int)(k % sizeX), z = (int)(k / sizeX);
 
         double* temp2 = buffer + omp_get_thread_num()*(buffSizeX+buffSizeY);
 
-        temp2[0] = B*(double)src(0,i,0) + b1*(double)src(0,i,0) + b2*(double)src(0,i,0) + b3*(double)src(0,i,0);
-        temp2[1] = B*(double)src(1,i,0) + b1*temp2[0]  + b2*(double)src(0,i,0) + b3*(double)src(0,i,0);
-        temp2[2] = B*(double)src(2,i,0) + b1*temp2[1]  + b2*temp2[0]  + b3*(double)src(0,i,0);
+        temp2[0] = B*(double)src(0,i,z) + b1*(double)src(0,i,z) + b2*(double)src(0,i,z) + b3*(double)src(0,i,z);
+        temp2[1] = B*(double)src(1,i,z) + b1*temp2[0]  + b2*(double)src(0,i,z) + b3*(double)src(0,i,z);
+        temp2[2] = B*(double)src(2,i,z) + b1*temp2[1]  + b2*temp2[0]  + b3*(double)src(0,i,z);
 
         for (int j=3; j<buffSizeY; j++)
-            temp2[j] = B*(double)src(j,i,0) + b1*temp2[j-1] + b2*temp2[j-2] + b3*temp2[j-3];
+            temp2[j] = B*(double)src(j,i,z) + b1*temp2[j-1] + b2*temp2[j-2] + b3*temp2[j-3];
 
-        double temp2Wm1 = (double)src(buffSizeY-1,i,0) + M[0][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M[0][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M[0][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
-        double temp2W   = (double)src(buffSizeY-1,i,0) + M[1][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M[1][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M[1][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
-        double temp2Wp1 = (double)src(buffSizeY-1,i,0) + M[2][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M[2][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M[2][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
+        double temp2Wm1 = (double)src(buffSizeY-1,i,z) + M[0][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + M[0][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + M[0][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
+        double temp2W   = (double)src(buffSizeY-1,i,z) + M[1][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + M[1][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + M[1][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
+        double temp2Wp1 = (double)src(buffSizeY-1,i,z) + M[2][0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + M[2][1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + M[2][2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
 
         temp2[buffSizeY-1] = temp2Wm1;
         temp2[buffSizeY-2] = B * temp2[buffSizeY-2] + b1*temp2[buffSizeY-1] + b2*temp2W + b3*temp2Wp1;
@@ -231,7 +426,7 @@ void GaussFilter::gaussHorizontal(CImg<double> &src){
         for (int j=buffSizeY-4; j>=0; j--)
             temp2[j] = B * temp2[j] + b1*temp2[j+1] + b2*temp2[j+2] + b3*temp2[j+3];
         for (int j=0; j<buffSizeY; j++)
-            src(j,i,0) = (double)temp2[j];
+            src(j,i,z) = (double)temp2[j];
     }
 }
 
@@ -248,29 +443,33 @@ void GaussFilter::spaceVariantGaussHorizontal(CImg<double> &src){
 
 #pragma omp parallel for
 
-    for (int i=0; i<sizeX; i++) {
+    for (long k=0; k<(long)sizeX*src.depth(); k++) {
+        const int i = (int)(k % sizeX), z = (int)(k / sizeX);
 
         double* temp2 = buffer + omp_get_thread_num()*(buffSizeX+buffSizeY);
+        // coefficients of row i (B,b1,b2,b3 of each pixel) and boundary matrix
+        const double *c = &svCoefficients->coefficients[4*(size_t)i*buffSizeY];
+        const double *m = &svCoefficients->rowM[9*i];
 
-        temp2[0] = B_m(0,i,0)*(double)src(0,i,0) + b1_m(0,i,0)*(double)src(0,i,0) + b2_m(0,i,0)*(double)src(0,i,0) + b3_m(0,i,0)*(double)src(0,i,0);
-        temp2[1] = B_m(1,i,0)*(double)src(1,i,0) + b1_m(1,i,0)*temp2[0]  + b2_m(1,i,0)*(double)src(0,i,0) + b3_m(1,i,0)*(double)src(0,i,0);
-        temp2[2] = B_m(2,i,0)*(double)src(2,i,0) + b1_m(2,i,0)*temp2[1]  + b2_m(2,i,0)*temp2[0]  + b3_m(2,i,0)*(double)src(0,i,0);
+        temp2[0] = c[0]*(double)src(0,i,z) + c[1]*(double)src(0,i,z) + c[2]*(double)src(0,i,z) + c[3]*(double)src(0,i,z);
+        temp2[1] = c[4]*(double)src(1,i,z) + c[5]*temp2[0]  + c[6]*(double)src(0,i,z) + c[7]*(double)src(0,i,z);
+        temp2[2] = c[8]*(double)src(2,i,z) + c[9]*temp2[1]  + c[10]*temp2[0]  + c[11]*(double)src(0,i,z);
 
         for (int j=3; j<buffSizeY; j++)
-            temp2[j] = B_m(j,i,0)*(double)src(j,i,0) + b1_m(j,i,0)*temp2[j-1] + b2_m(j,i,0)*temp2[j-2] + b3_m(j,i,0)*temp2[j-3];
+            temp2[j] = c[4*j]*(double)src(j,i,z) + c[4*j+1]*temp2[j-1] + c[4*j+2]*temp2[j-2] + c[4*j+3]*temp2[j-3];
 
-        double temp2Wm1 = (double)src(buffSizeY-1,i,0) + M_m(0,i,0)*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,1)*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,2)*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
-        double temp2W   = (double)src(buffSizeY-1,i,0) + M_m(0,i,3)*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,4)*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,5)*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
-        double temp2Wp1 = (double)src(buffSizeY-1,i,0) + M_m(0,i,6)*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,7)*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,0)) + M_m(0,i,8)*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,0));
+        double temp2Wm1 = (double)src(buffSizeY-1,i,z) + m[0]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + m[1]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + m[2]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
+        double temp2W   = (double)src(buffSizeY-1,i,z) + m[3]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + m[4]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + m[5]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
+        double temp2Wp1 = (double)src(buffSizeY-1,i,z) + m[6]*(temp2[buffSizeY-1] - (double)src(buffSizeY-1,i,z)) + m[7]*(temp2[buffSizeY-2] - (double)src(buffSizeY-1,i,z)) + m[8]*(temp2[buffSizeY-3] - (double)src(buffSizeY-1,i,z));
 
         temp2[buffSizeY-1] = temp2Wm1;
-        temp2[buffSizeY-2] = B_m(buffSizeY-2,i,0) * temp2[buffSizeY-2] + b1_m(buffSizeY-2,i,0)*temp2[buffSizeY-1] + b2_m(buffSizeY-2,i,0)*temp2W + b3_m(buffSizeY-2,i,0)*temp2Wp1;
-        temp2[buffSizeY-3] = B_m(buffSizeY-3,i,0) * temp2[buffSizeY-3] + b1_m(buffSizeY-3,i,0)*temp2[buffSizeY-2] + b2_m(buffSizeY-3,i,0)*temp2[buffSizeY-1] + b3_m(buffSizeY-3,i,0)*temp2W;
+        temp2[buffSizeY-2] = c[4*(buffSizeY-2)] * temp2[buffSizeY-2] + c[4*(buffSizeY-2)+1]*temp2[buffSizeY-1] + c[4*(buffSizeY-2)+2]*temp2W + c[4*(buffSizeY-2)+3]*temp2Wp1;
+        temp2[buffSizeY-3] = c[4*(buffSizeY-3)] * temp2[buffSizeY-3] + c[4*(buffSizeY-3)+1]*temp2[buffSizeY-2] + c[4*(buffSizeY-3)+2]*temp2[buffSizeY-1] + c[4*(buffSizeY-3)+3]*temp2W;
 
         for (int j=buffSizeY-4; j>=0; j--)
-            temp2[j] = B_m(j,i,0) * temp2[j] + b1_m(j,i,0)*temp2[j+1] + b2_m(j,i,0)*temp2[j+2] + b3_m(j,i,0)*temp2[j+3];
+            temp2[j] = c[4*j] * temp2[j] + c[4*j+1]*temp2[j+1] + c[4*j+2]*temp2[j+2] + c[4*j+3]*temp2[j+3];
         for (int j=0; j<buffSizeY; j++)
-            src(j,i,0) = (double)temp2[j];
+            src(j,i,z) = (double)temp2[j];
     }
 }
 
@@ -278,31 +477,38 @@ void GaussFilter::spaceVariantGaussHorizontal(CImg<double> &src){
 
 void GaussFilter::spaceVariantGaussVertical(CImg<double> &src){
 
+    // distance between the coefficients of consecutive rows
+    const size_t stride = 4*(size_t)buffSizeY;
+
 #pragma omp parallel for
 
-    for (int i=0; i<sizeY; i++) {
+    for (long k=0; k<(long)sizeY*src.depth(); k++) {
+        const int i = (int)(k % sizeY), z = (int)(k / sizeY);
 
         double* temp2 = buffer + omp_get_thread_num()*(buffSizeX+buffSizeY);
+        // coefficients of column i (B,b1,b2,b3 of each pixel) and boundary matrix
+        const double *c = &svCoefficients->coefficients[4*(size_t)i];
+        const double *m = &svCoefficients->columnM[9*i];
 
-        temp2[0] = B_m(i,0,0)*(double)src(i,0,0) + b1_m(i,0,0)*(double)src(i,0,0) + b2_m(i,0,0)*(double)src(i,0,0) + b3_m(i,0,0)*(double)src(i,0,0);
-        temp2[1] = B_m(i,1,0)*(double)src(i,1,0) + b1_m(i,1,0)*temp2[0]  + b2_m(i,1,0)*(double)src(i,0,0) + b3_m(i,1,0)*(double)src(i,0,0);
-        temp2[2] = B_m(i,2,0)*(double)src(i,2,0) + b1_m(i,2,0)*temp2[1]  + b2_m(i,2,0)*temp2[0]  + b3_m(i,2,0)*(double)src(i,0,0);
+        temp2[0] = c[0]*(double)src(i,0,z) + c[1]*(double)src(i,0,z) + c[2]*(double)src(i,0,z) + c[3]*(double)src(i,0,z);
+        temp2[1] = c[stride]*(double)src(i,1,z) + c[stride+1]*temp2[0]  + c[stride+2]*(double)src(i,0,z) + c[stride+3]*(double)src(i,0,z);
+        temp2[2] = c[stride*2]*(double)src(i,2,z) + c[stride*2+1]*temp2[1]  + c[stride*2+2]*temp2[0]  + c[stride*2+3]*(double)src(i,0,z);
 
         for (int j=3; j<buffSizeX; j++)
-            temp2[j] = B_m(i,j,0)*(double)src(i,j,0) + b1_m(i,j,0)*temp2[j-1] + b2_m(i,j,0)*temp2[j-2] + b3_m(i,j,0)*temp2[j-3];
+            temp2[j] = c[stride*j]*(double)src(i,j,z) + c[stride*j+1]*temp2[j-1] + c[stride*j+2]*temp2[j-2] + c[stride*j+3]*temp2[j-3];
 
-        double temp2Wm1 = (double)src(i,buffSizeX-1,0) + M_m(i,0,0)*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,1)*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,2)*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
-        double temp2W   = (double)src(i,buffSizeX-1,0) + M_m(i,0,3)*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,4)*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,5)*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
-        double temp2Wp1 = (double)src(i,buffSizeX-1,0) + M_m(i,0,6)*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,7)*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,0)) + M_m(i,0,8)*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,0));
+        double temp2Wm1 = (double)src(i,buffSizeX-1,z) + m[0]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + m[1]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + m[2]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
+        double temp2W   = (double)src(i,buffSizeX-1,z) + m[3]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + m[4]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + m[5]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
+        double temp2Wp1 = (double)src(i,buffSizeX-1,z) + m[6]*(temp2[buffSizeX-1] - (double)src(i,buffSizeX-1,z)) + m[7]*(temp2[buffSizeX-2] - (double)src(i,buffSizeX-1,z)) + m[8]*(temp2[buffSizeX-3] - (double)src(i,buffSizeX-1,z));
 
         temp2[buffSizeX-1] = temp2Wm1;
-        temp2[buffSizeX-2] = B_m(i,buffSizeX-2,0) * temp2[buffSizeX-2] + b1_m(i,buffSizeX-2,0)*temp2[buffSizeX-1] + b2_m(i,buffSizeX-2,0)*temp2W + b3_m(i,buffSizeX-2,0)*temp2Wp1;
-        temp2[buffSizeX-3] = B_m(i,buffSizeX-3,0) * temp2[buffSizeX-3] + b1_m(i,buffSizeX-3,0)*temp2[buffSizeX-2] + b2_m(i,buffSizeX-3,0)*temp2[buffSizeX-1] + b3_m(i,buffSizeX-3,0)*temp2W;
+        temp2[buffSizeX-2] = c[stride*(buffSizeX-2)] * temp2[buffSizeX-2] + c[stride*(buffSizeX-2)+1]*temp2[buffSizeX-1] + c[stride*(buffSizeX-2)+2]*temp2W + c[stride*(buffSizeX-2)+3]*temp2Wp1;
+        temp2[buffSizeX-3] = c[stride*(buffSizeX-3)] * temp2[buffSizeX-3] + c[stride*(buffSizeX-3)+1]*temp2[buffSizeX-2] + c[stride*(buffSizeX-3)+2]*temp2[buffSizeX-1] + c[stride*(buffSizeX-3)+3]*temp2W;
 
         for (int j=buffSizeX-4; j>=0; j--)
-            temp2[j] = B_m(i,j,0) * temp2[j] + b1_m(i,j,0)*temp2[j+1] + b2_m(i,j,0)*temp2[j+2] + b3_m(i,j,0)*temp2[j+3];
+            temp2[j] = c[stride*j] * temp2[j] + c[stride*j+1]*temp2[j+1] + c[stride*j+2]*temp2[j+2] + c[stride*j+3]*temp2[j+3];
         for (int j=0; j<buffSizeX; j++)
-            src(i,j,0) = (double)temp2[j];
+            src(i,j,z) = (double)temp2[j];
     }
 }
 
@@ -325,6 +531,13 @@ void GaussFilter::feedInput(double sim_time, const CImg<double> &new_input, bool
 
 
 void GaussFilter::update(){
+    if(reducedFilter != NULL){
+        decimate(*inputImage, *(reducedFilter->inputImage));
+        reducedFilter->update();
+        upsample(*(reducedFilter->outputImage), *outputImage);
+        return;
+    }
+
     if(spaceVariantSigma)
         spaceVariantGaussFiltering(*inputImage);
     else
@@ -340,6 +553,10 @@ CImg<double>* GaussFilter::getOutput(){
     return outputImage;
 }
 
+bool GaussFilter::isStateless(){
+    return true;
+}
+
 //------------------------------------------------------------------------------//
 
 double GaussFilter::density(double r){
@@ -368,6 +585,12 @@ int GaussFilter::setParameters(vector<double> params, vector<string> paramID){
             K = params[i];
         }else if (strcmp(s,"R0")==0){
             R0 = params[i];
+        }else if (strcmp(s,"MR_threshold")==0){
+            if(!setMRThreshold(params[i]))
+                err_param_num = -(i+1);
+        }else if (strcmp(s,"MR_sigma")==0){
+            if(!setMRSigma(params[i]))
+                err_param_num = -(i+1);
         }
         else{
               err_param_num = i+1; // return number of erroneous parameter
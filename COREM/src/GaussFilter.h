@@ -7,7 +7,8 @@
  * Description: Gaussian convolution to reproduce spatial integration in chemical
  * and gap-junction synapses. It implements a recursive infinite-impulse-response
  * (IIR) filter based on the Deriche's algorithm. Based on [1,2]. OpenMP is used
- * for multithreading
+ * for multithreading (the rows and columns of all the slices of a batch are filtered
+ * in parallel)
  *
  * [1] Triggs, Bill, and Michaël Sdika. "Boundary conditions for Young-van Vliet
  * recursive filtering." Signal Processing, IEEE Transactions on 54.6 (2006):
@@ -19,6 +20,22 @@
  *
  * Source code adapted from RawTherapee library. <http://rawtherapee.com/>
  *
+ * The per-pixel coefficients of the space-variant filter are stored interleaved
+ * (B,b1,b2,b3 of each pixel are contiguous), and the boundary matrices only for the
+ * pixels where the recursions start. They are shared by all the filters with the same
+ * size, sigma, K, R0 and pixels per degree, so models with many identical filters
+ * compute and store them once.
+ *
+ * Large sigmas are filtered at reduced resolution: when sigma (in pixels) exceeds
+ * MR_threshold, the input is decimated by a factor of sigma/MR_sigma (averaging blocks of
+ * pixels), filtered with the sigma of the reduced grid (compensated for the blur of the
+ * averaging) and upsampled with bilinear interpolation. The reduced grid is extended by
+ * 3 sigmas with the averages of the image extended with its edge values (the boundary
+ * condition of the filter at full resolution). MR_sigma is the smallest sigma in
+ * pixels of the reduced filter: larger values are more accurate and slower (the error is
+ * about 0.5% of the maximum of the output at edges with the default value, 4). The
+ * default threshold is 16 pixels, and MR_threshold = 0 disables the multi-resolution mode.
+ *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
  *
@@ -26,6 +43,8 @@
  */
 
 #include <omp.h>
+#include <vector>
+#include <algorithm>
 #include "module.h"
 
 using namespace std;
@@ -45,11 +64,48 @@ protected:
     double q,b0,b1,b2,b3,B;
     // Matrices
     double M[3][3];
-    CImg <double> q_m,b0_m,b1_m,b2_m,b3_m,B_m,M_m;
     //spaceVariantSigma
     bool spaceVariantSigma;
     double R0,K;
 
+    // Coefficients of the space-variant filter, shared by the filters with the same parameters
+    struct SpaceVariantCoefficients{
+        int sizeX, sizeY;
+        double sigma, K, R0, pixelsPerDegree;
+        // Number of filters using the coefficients
+        int users;
+        // B,b1,b2,b3 of pixel (x,y) at 4*(y*buffSizeY+x)
+        vector<double> coefficients;
+        // Boundary matrices (9 values) of the pixels of the first column (horizontal
+        // recursion) and of the first row (vertical recursion)
+        vector<double> rowM, columnM;
+    };
+    SpaceVariantCoefficients *svCoefficients;
+    static vector<SpaceVariantCoefficients*> coefficientCache;
+
+    // Get the coefficients of the current parameters from the cache (they are computed if
+    // no other filter uses them) and release them
+    SpaceVariantCoefficients* acquireCoefficients();
+    static void releaseCoefficients(SpaceVariantCoefficients *coefs);
+    void computeCoefficients(SpaceVariantCoefficients &coefs);
+    // Boundary matrix (3x3, row-major) of the recursion with coefficients b1, b2 and b3
+    static void boundaryMatrix(double b1, double b2, double b3, double *m);
+
+    // Multi-resolution mode: sigma threshold and minimum reduced sigma (in pixels), decimation
+    // factor and filter of the reduced grid (NULL at full resolution)
+    double MRThreshold, MRSigma;
+    int decimationFactor;
+    GaussFilter *reducedFilter;
+    // Pixels of each block of the reduced grid (clamped to the image, the reduced grid extends
+    // beyond the image to reproduce the constant extension at the boundaries)
+    vector<int> decimateColumn, decimateRow;
+    // Reduced pixels and weights of the bilinear interpolation of each column and row
+    vector<int> upsampleColumn, upsampleRow;
+    vector<double> upsampleColumnWeight, upsampleRowWeight;
+    void allocateReducedFilter();
+    void decimate(const CImg<double> &src, CImg<double> &reduced);
+    void upsample(const CImg<double> &reduced, CImg<double> &dst);
+
     CImg<double> *inputImage;
     CImg<double> *outputImage;
 
@@ -63,6 +119,10 @@ public:
     // Allocate values and set protected parameters
     virtual bool allocateValues();
     bool setSigma(double sigm);
+    bool setMRThreshold(double threshold);
+    bool setMRSigma(double reduced_sigma);
+    // The pixels per degree of the module grid are reduced by the downsampling factor
+    virtual bool setDownsample(int factor);
 
     // Fast filtering with constant sigma
     void gaussHorizontal(CImg<double> &src);
@@ -82,6 +142,8 @@ public:
     virtual int setParameters(vector<double> params, vector<string> paramID);
     // Get output image (y(k))
     virtual CImg<double>* getOutput();
+    // The filter is purely spatial
+    virtual bool isStateless();
 
 };
 
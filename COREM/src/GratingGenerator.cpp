@@ -37,7 +37,24 @@ GratingGenerator::GratingGenerator(int ptype, double pstep, double plengthB, dou
     cos_theta=cos(theta);
     sin_theta=sin(theta);
     A=Cont*Lum;
-    aux = *(new CImg <double>(Y,X,1,3));
+
+    // If all the color channels have the same phase they are proportional to the luminance
+    // grating, which is generated alone (the channel weights are applied by the retina)
+    luminanceOnly = (red_phi == green_phi && green_phi == blue_phi);
+    aux.assign(Y,X,1,luminanceOnly? 1 : 3);
+
+    // Spatial phase of each pixel
+    Pi = 3.14159265;
+    cosPhase.assign(Y,X,1,1);
+    sinPhase.assign(Y,X,1,1);
+    cimg_forXY(cosPhase,x,y) {
+        double spatial_phase = (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi;
+        cosPhase(x,y) = cos(spatial_phase);
+        sinPhase(x,y) = sin(spatial_phase);
+    }
+
+    lastInterval = -1;
+    frameVersion = 0;
 }
 
 GratingGenerator::GratingGenerator(const GratingGenerator& copy){
@@ -50,73 +67,81 @@ GratingGenerator::~GratingGenerator(void){
 
 //------------------------------------------------------------------------------//
 
-CImg <double>* GratingGenerator::compute_grating(double t){
-
-    if(t>=0 && t<Bsize){
-       cimg_forXY(aux,x,y) {
-           aux(x,y,0,0) = r*Lum,
-           aux(x,y,0,1) = g*Lum,
-           aux(x,y,0,2) = b*Lum;
-       }
+// value = weight*Lum + sign*weight*A*modulation*cos(spatial_phase + channel_phase*Pi + temporal_phase)
+// The cosine is expanded with the angle-addition identity, so for each frame only two scalars
+// per channel are computed and the precomputed cos/sin maps of the spatial phase are combined
+void GratingGenerator::drawGrating(double sign, double temporal_phase, double modulation){
+    double weight[3] = {r, g, b};
+    if(luminanceOnly)
+        weight[0] = 1.0;
+    double channel_phi[3] = {red_phi, green_phi, blue_phi};
+    long n_pixels = (long)aux.width()*aux.height();
+    const double *cos_map = cosPhase.data();
+    const double *sin_map = sinPhase.data();
+
+    for(int c=0;c<aux.spectrum();c++){
+        double base = weight[c]*Lum;
+        double amplitude = sign*weight[c]*A*modulation;
+        double cos_coef = amplitude*cos(channel_phi[c]*Pi + temporal_phase);
+        double sin_coef = amplitude*sin(channel_phi[c]*Pi + temporal_phase);
+        double *out = aux.data(0,0,0,c);
+
+        #pragma omp parallel for if(n_pixels >= 32768)
+        for(long i=0;i<n_pixels;i++)
+            out[i] = base + cos_coef*cos_map[i] - sin_coef*sin_map[i];
     }
+}
 
-   double Pi = 3.14159265;
-
-
-   if(t>=Bsize && t<Bsize+first_grating_size){
-       if(type==0){
-                   cimg_forXY(aux,x,y) {
-
-                           double value3 = b*Lum + b * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 - freq*step*t)*2*Pi + blue_phi*Pi);
-                           double value2 = g*Lum + g * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 - freq*step*t)*2*Pi + green_phi*Pi);
-                           double value1 = r*Lum + r * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 - freq*step*t)*2*Pi + red_phi*Pi);
-                           aux(x,y,0,0)=value1;
-                           aux(x,y,0,1)=value2;
-                           aux(x,y,0,2)=value3;
-                   }
-
-       }else
-       {
-         if(type==1){
-             cimg_forXY(aux,x,y) {
-                     double value3 = b*Lum + b * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 )*2*Pi + blue_phi*Pi) * cos((freq*step*t+phi_t/2)*2*Pi);
-                     double value2 = g*Lum + g * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 )*2*Pi + green_phi*Pi) * cos((freq*step*t+phi_t/2)*2*Pi);
-                     double value1 = r*Lum + r * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2 )*2*Pi + red_phi*Pi) * cos((freq*step*t+phi_t/2)*2*Pi);
-                     aux(x,y,0,0)=value1;
-                     aux(x,y,0,1)=value2;
-                     aux(x,y,0,2)=value3;
-
-             }
-         }
-         else{
-             cimg_forXY(aux,x,y) {
-                     double value3 = b*Lum + b * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + blue_phi*Pi);
-                     double value2 = g*Lum + g * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + green_phi*Pi);
-                     double value1 = r*Lum + r * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + red_phi*Pi);
-                     aux(x,y,0,0)=value1;
-                     aux(x,y,0,1)=value2;
-                     aux(x,y,0,2)=value3;
-
-                }
-           }
-       }
-   }
-
-
-   //adding the reversed grating in case that type==2
-   if(t>=Bsize+first_grating_size && t<Bsize+first_grating_size+second_grating_size){
-       cimg_forXY(aux,x,y) {
-             double value3 = b*Lum - b * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + blue_phi*Pi);
-             double value2 = g*Lum - g * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + green_phi*Pi);
-             double value1 = r*Lum - r * A *cos( (((x-x0)*cos_theta+(y-y0)*sin_theta)/T + phi/2)*2*Pi + red_phi*Pi);
-             aux(x,y,0,0)=value1;
-             aux(x,y,0,1)=value2;
-             aux(x,y,0,2)=value3;
-
-       }
-   }
-
+CImg <double>* GratingGenerator::compute_grating(double t){
+    int interval = -1; // Blank (0), first grating (1), second grating (2) or end (-1, image not changed)
+
+    if(t>=0 && t<Bsize)
+        interval = 0;
+    else if(t>=Bsize && t<Bsize+first_grating_size)
+        interval = 1;
+    else if(t>=Bsize+first_grating_size && t<Bsize+first_grating_size+second_grating_size)
+        interval = 2;
+
+    // Only the first grating of types 0 (drifting) and 1 (oscillating) changes within an interval,
+    // otherwise the image is only drawn when the interval starts
+    if(interval != -1 && (interval != lastInterval || (interval == 1 && (type == 0 || type == 1)))){
+        frameVersion++;
+
+        if(interval == 0){
+            if(luminanceOnly)
+                aux.fill(Lum);
+            else{
+                aux.get_shared_channel(0).fill(r*Lum);
+                aux.get_shared_channel(1).fill(g*Lum);
+                aux.get_shared_channel(2).fill(b*Lum);
+            }
+        }else if(interval == 1){
+            if(type==0) // drifting grating
+                drawGrating(1.0, -freq*step*t*2*Pi, 1.0);
+            else if(type==1) // counter-phase grating
+                drawGrating(1.0, 0.0, cos((freq*step*t+phi_t/2)*2*Pi));
+            else // static grating
+                drawGrating(1.0, 0.0, 1.0);
+        }else //adding the reversed grating in case that type==2
+            drawGrating(-1.0, 0.0, 1.0);
+    }
+    lastInterval = interval;
 
    return &aux;
 }
 
+//------------------------------------------------------------------------------//
+
+double GratingGenerator::getChannelGain(int channel){
+    double gain = 1.0;
+
+    if(luminanceOnly){
+        if(channel == 0)
+            gain = r;
+        else if(channel == 1)
+            gain = g;
+        else
+            gain = b;
+    }
+    return(gain);
+}
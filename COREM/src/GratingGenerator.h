@@ -25,6 +25,9 @@
  * r,g,b -> weight of each color channel.
  * red_phi,green_phi,blue_phi -> initial phase for each color channel.
  *
+ * When the three color channels have the same phase, the grating is generated as a
+ * single-channel luminance image and the retina applies the channel weights.
+ *
  * Source code adapted from Virtual Retina[1] (licensed under CeCILL-C)
  *
  * [1] Wohrer, Adrien, and Pierre Kornprobst. "Virtual Retina: a biological retina
@@ -75,8 +78,18 @@ protected:
 
     double red_phi,green_phi,blue_phi;
 
-    // Aux matrix
+    // Aux matrix (a single luminance channel if all the color channels have the same phase)
     CImg <double> aux;
+    bool luminanceOnly;
+
+    // Cosine and sine of the spatial phase of each pixel (precomputed)
+    double Pi;
+    CImg <double> cosPhase, sinPhase;
+    void drawGrating(double sign, double temporal_phase, double modulation);
+
+    // Version of the grating image: it changes when the grating moves or a new interval starts
+    int lastInterval;
+    unsigned long frameVersion;
 
 public:
     // Constructor, copy, destructor.
@@ -87,6 +100,13 @@ public:
 
     // update the grating
     CImg<double> *compute_grating(double t);
+
+    // version of the grating image
+    unsigned long getFrameVersion(){return frameVersion;}
+
+    // gain of a color channel (0: red, 1: green, 2: blue) with respect to the grating image.
+    // It is the channel weight if the grating is a luminance image, 1 otherwise
+    double getChannelGain(int channel);
 };
 
 #endif // GRATINGGENERATOR_H
@@ -0,0 +1,49 @@
+#include "ModuleAlias.h"
+
+ModuleAlias::ModuleAlias(module *target_module, int x, int y, double temporal_step):module(x,y,temporal_step){
+    target = target_module;
+}
+
+ModuleAlias::ModuleAlias(const ModuleAlias &copy):module(copy){
+    target = copy.target;
+}
+
+ModuleAlias::~ModuleAlias(){
+}
+
+//------------------------------------------------------------------------------//
+
+void ModuleAlias::setTarget(module *target_module){
+    target = target_module;
+}
+
+module *ModuleAlias::getTarget(){
+    return target;
+}
+
+//------------------------------------------------------------------------------//
+
+void ModuleAlias::feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port){
+    simTime = sim_time;
+}
+
+void ModuleAlias::update(){
+}
+
+//------------------------------------------------------------------------------//
+
+CImg<double>* ModuleAlias::getOutput(){
+    return target->getOutput();
+}
+
+unsigned long ModuleAlias::getOutputVersion(){
+    return target->getOutputVersion();
+}
+
+bool ModuleAlias::isDummy(){
+    return false;
+}
+
+bool ModuleAlias::isStateless(){
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef MODULEALIAS_H
+#define MODULEALIAS_H
+
+/* BeginDocumentation
+ * Name: ModuleAlias
+ *
+ * Description: Special retina module that replaces a module which computes the same output
+ *              as other module of the retina (see Retina::mergeDuplicateModules()). It keeps the
+ *              ID and the position of the replaced module, so connections, displays and
+ *              multimeters can still use it, but it performs no computation: its output is the
+ *              output of the target module.
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ *
+ * SeeAlso: module, Retina
+ */
+
+#include "module.h"
+
+using namespace cimg_library;
+using namespace std;
+
+class ModuleAlias: public module{
+protected:
+    // Module which computes the output
+    module *target;
+
+public:
+    // Constructor, copy, destructor.
+    ModuleAlias(module *target_module, int x=1, int y=1, double temporal_step=1.0);
+    ModuleAlias(const ModuleAlias& copy);
+    ~ModuleAlias(void);
+
+    // Set and get the module which computes the output
+    void setTarget(module *target_module);
+    module *getTarget();
+
+    // The alias has no inputs and no state
+    virtual void feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port);
+    virtual void update();
+
+    // Output image and its version are those of the target module
+    virtual CImg<double>* getOutput();
+    virtual unsigned long getOutputVersion();
+
+    // Returns false to indicate that this class is not a dummy module
+    virtual bool isDummy();
+    // Its update is skipped by the retina
+    virtual bool isStateless();
+};
+
+#endif // MODULEALIAS_H
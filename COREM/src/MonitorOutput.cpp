@@ -0,0 +1,421 @@
+#include <iostream>
+#include <limits>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "MonitorOutput.h"
+#include "constants.h"
+
+#define FIRST_IP_PORT 1
+#define LAST_IP_PORT 65535
+
+MonitorOutput::MonitorOutput(int x, int y, double temporal_step, string conn_url):module(x,y,temporal_step){
+    // Default parameters: publish a full-resolution frame at every step during all the simulation
+    Start_time=0.0;
+    End_time=numeric_limits<double>::infinity();
+    FramePeriod=0.0;
+    Downsample=1;
+
+    if(conn_url.compare("") != 0)
+        connection_url=conn_url;
+    else
+        connection_url="unix:results/monitor.sock";
+
+    socket_fd=-1;
+    client_fd=-1;
+    connection_opened=false;
+    pending_offset=0;
+    num_sent_frames=0;
+    num_dropped_frames=0;
+    NextFrameTime=0.0;
+}
+
+MonitorOutput::MonitorOutput(const MonitorOutput &copy):module(copy){
+    connection_url = copy.connection_url;
+    Start_time = copy.Start_time;
+    End_time = copy.End_time;
+    FramePeriod = copy.FramePeriod;
+    Downsample = copy.Downsample;
+    Probe_x = copy.Probe_x;
+    Probe_y = copy.Probe_y;
+
+    // The copy does not share the socket of the original object
+    socket_fd=-1;
+    client_fd=-1;
+    connection_opened=false;
+    pending_offset=0;
+    num_sent_frames=0;
+    num_dropped_frames=0;
+    NextFrameTime=copy.NextFrameTime;
+
+    for(size_t i=0;i<copy.inputImages.size();i++)
+        inputImages.push_back(new CImg<double>(*copy.inputImages[i]));
+}
+
+MonitorOutput::~MonitorOutput(){
+    if(num_sent_frames > 0 || num_dropped_frames > 0)
+        cout << "Monitor output " << connection_url << ": " << num_sent_frames << " frames sent, " << num_dropped_frames << " dropped." << endl;
+    closeConnection();
+
+    for(size_t i=0;i<inputImages.size();i++)
+        delete inputImages[i];
+}
+
+//------------------------------------------------------------------------------//
+
+bool MonitorOutput::allocateValues(){
+    module::allocateValues(); // Use the allocateValues() method of the base class
+
+    for(size_t i=0;i<inputImages.size();i++)
+        inputImages[i]->assign(sizeY, sizeX, batchSize, 1, 0);
+    NextFrameTime=Start_time;
+    return(true);
+}
+
+bool MonitorOutput::set_Start_time(double start_time){
+    bool ret_correct;
+    if (start_time>=0) {
+        Start_time = start_time;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool MonitorOutput::set_End_time(double end_time){
+    bool ret_correct;
+    if (end_time>=0) {
+        End_time = end_time;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool MonitorOutput::set_FramePeriod(double period){
+    bool ret_correct;
+    if (period>=0) {
+        FramePeriod = period;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool MonitorOutput::set_Downsample(int factor){
+    bool ret_correct;
+    if (factor>0) {
+        Downsample = factor;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool MonitorOutput::add_Probe_x(int x){
+    bool ret_correct;
+    if (x>=0) {
+        Probe_x.push_back(x);
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+bool MonitorOutput::add_Probe_y(int y){
+    bool ret_correct;
+    if (y>=0) {
+        Probe_y.push_back(y);
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+//------------------------------------------------------------------------------//
+
+int MonitorOutput::setParameters(vector<double> params, vector<string> paramID){
+
+    int err_param_num=0; // default, no error
+
+    for (vector<double>::size_type i = 0;i < params.size() && err_param_num==0;i++){
+        const char * s = paramID[i].c_str();
+
+        if (strcmp(s,"Start_time")==0){
+            if(!set_Start_time(params[i]))
+                err_param_num = -(i+1); // If parameter value could not be set, return the number of problematic parameter (negated)
+        }else if (strcmp(s,"End_time")==0){
+            if(!set_End_time(params[i]))
+                err_param_num = -(i+1);
+        }else if (strcmp(s,"FramePeriod")==0){
+            if(!set_FramePeriod(params[i]))
+                err_param_num = -(i+1);
+        }else if (strcmp(s,"Downsample")==0){
+            if(!set_Downsample((int)params[i]))
+                err_param_num = -(i+1);
+        }else if (strcmp(s,"Probe_x")==0){
+            if(!add_Probe_x((int)params[i]))
+                err_param_num = -(i+1);
+        }else if (strcmp(s,"Probe_y")==0){
+            if(!add_Probe_y((int)params[i]))
+                err_param_num = -(i+1);
+        } else{
+              err_param_num = i+1;
+        }
+    }
+    if(err_param_num == 0 && Probe_x.size() != Probe_y.size()){
+        cout << "Error: The number of Probe_x and Probe_y parameters of a monitor output must be equal" << endl;
+        err_param_num = params.size(); // Any of the parameters
+    }
+    return err_param_num;
+}
+
+//------------------------------------------------------------------------------//
+
+void MonitorOutput::feedInput(double sim_time, const CImg<double>& new_input,bool isCurrent,int port){
+    // Ignore port type and copy input image in the buffer of this port
+    while((size_t)port >= inputImages.size())
+        inputImages.push_back(new CImg<double>(sizeY, sizeX, 1, 1, 0));
+    *inputImages[port] = new_input;
+    simTime = sim_time;
+}
+
+//------------------------------------------------------------------------------//
+
+void MonitorOutput::update(){
+    // The listening socket is created at the first update (not when the script is parsed), so
+    // several retinas can be loaded in the same process. Viewers are accepted during the simulation
+    if(!connection_opened){
+        connection_opened=true;
+        openConnection();
+    }
+    if(socket_fd == -1)
+        return;
+
+    if(client_fd == -1)
+        acceptViewer();
+
+    if(client_fd != -1 && simTime >= Start_time && simTime+step <= End_time){
+        bool send_frames = (simTime >= NextFrameTime);
+        if(send_frames){
+            NextFrameTime += (FramePeriod > step)? FramePeriod : step;
+            if(NextFrameTime <= simTime) // The viewer has been connected late: do not send the missed frames
+                NextFrameTime = simTime + ((FramePeriod > step)? FramePeriod : step);
+        }
+
+        // Messages are only queued if the previous ones have been completely sent, otherwise they are dropped
+        if(flushPending() && client_fd != -1){
+            pending_msgs.clear();
+            pending_offset=0;
+            for(size_t port=0;port<inputImages.size();port++){
+                if(send_frames)
+                    appendFrame(pending_msgs, port);
+                if(Probe_x.size() > 0)
+                    appendSamples(pending_msgs, port);
+            }
+            if(send_frames)
+                num_sent_frames++;
+            flushPending();
+        } else if(send_frames)
+            num_dropped_frames++;
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+void MonitorOutput::appendHeader(vector<unsigned char> &msg, uint16_t type, uint16_t port, uint32_t payload_len){
+    unsigned char header[MONITOR_HEADER_LEN];
+    uint32_t magic=MONITOR_MAGIC;
+    double sim_time=simTime;
+
+    memcpy(header, &magic, 4);
+    memcpy(header+4, &type, 2);
+    memcpy(header+6, &port, 2);
+    memcpy(header+8, &payload_len, 4);
+    memcpy(header+12, &sim_time, 8);
+    msg.insert(msg.end(), header, header+MONITOR_HEADER_LEN);
+}
+
+void MonitorOutput::appendFrame(vector<unsigned char> &msg, int port){
+    CImg<double> &img = *inputImages[port];
+    uint16_t width = (uint16_t)((img.width()+Downsample-1)/Downsample);
+    uint16_t height = (uint16_t)((img.height()+Downsample-1)/Downsample);
+    float min_val, max_val;
+    size_t data_start;
+
+    // Block averages are computed first to find the range of the published frame
+    CImg<double> small_img(width, height, 1, 1, 0.0);
+    if(Downsample == 1)
+        small_img = img.get_shared_slice(0,0); // First stimulus of a batch
+    else{
+        CImg<double> count(width, height, 1, 1, 0.0);
+        cimg_forXY(img,x,y){
+            small_img(x/Downsample,y/Downsample) += img(x,y,0,0);
+            count(x/Downsample,y/Downsample) += 1.0;
+        }
+        small_img.div(count);
+    }
+
+    double max_d, min_d = small_img.min_max(max_d);
+    min_val = (float)min_d;
+    max_val = (float)max_d;
+
+    appendHeader(msg, MONITOR_FRAME_MSG, (uint16_t)port, 12 + (uint32_t)width*height);
+    msg.insert(msg.end(), (unsigned char *)&width, (unsigned char *)&width+2);
+    msg.insert(msg.end(), (unsigned char *)&height, (unsigned char *)&height+2);
+    msg.insert(msg.end(), (unsigned char *)&min_val, (unsigned char *)&min_val+4);
+    msg.insert(msg.end(), (unsigned char *)&max_val, (unsigned char *)&max_val+4);
+
+    // 8-bit quantization
+    data_start = msg.size();
+    msg.resize(data_start + (size_t)width*height);
+    double scale = (max_d-min_d > 0)? 255.0/(max_d-min_d) : 0.0;
+    const double *src = small_img.data();
+    for(size_t i=0;i<(size_t)width*height;i++)
+        msg[data_start+i] = (unsigned char)((src[i]-min_d)*scale + 0.5);
+}
+
+void MonitorOutput::appendSamples(vector<unsigned char> &msg, int port){
+    CImg<double> &img = *inputImages[port];
+    uint32_t num_probes = Probe_x.size();
+
+    appendHeader(msg, MONITOR_SAMPLES_MSG, (uint16_t)port, 4 + 4*num_probes);
+    msg.insert(msg.end(), (unsigned char *)&num_probes, (unsigned char *)&num_probes+4);
+    for(size_t p=0;p<num_probes;p++){
+        float value = (float)img.atXY(Probe_x[p], Probe_y[p], 0, 0, 0.0); // 0 outside the layer
+        msg.insert(msg.end(), (unsigned char *)&value, (unsigned char *)&value+4);
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+// This method creates a non-blocking listening socket
+bool MonitorOutput::openConnection(){
+    bool ret_correct;
+    string tcp_any_format = "tcp://passive:";
+    string tcp_local_format = "tcp://localhost:";
+    string unix_format = "unix:";
+
+    ret_correct = false;
+    if(connection_url.compare(0, tcp_any_format.size(), tcp_any_format) == 0 || connection_url.compare(0, tcp_local_format.size(), tcp_local_format) == 0) {
+        bool loopback = (connection_url.compare(0, tcp_local_format.size(), tcp_local_format) == 0);
+        int port_number = atoi(connection_url.substr(loopback? tcp_local_format.size() : tcp_any_format.size()).c_str());
+
+        if(port_number >= FIRST_IP_PORT && port_number <= LAST_IP_PORT) { // Valid port numbers
+            socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if(socket_fd != -1) {
+                struct sockaddr_in serv_addr;
+                int reuse = 1;
+
+                setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                memset((void *)&serv_addr, 0, sizeof(serv_addr));
+                serv_addr.sin_family = AF_INET;
+                serv_addr.sin_port = htons(port_number);
+                serv_addr.sin_addr.s_addr = loopback? htonl(INADDR_LOOPBACK) : INADDR_ANY;
+                ret_correct = (bind(socket_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) != -1);
+            }
+        } else
+            cout << "Incorrect monitor port number specified: " << port_number << ". Expected a number in [" << FIRST_IP_PORT << "," << LAST_IP_PORT << "]." << endl;
+    } else if(connection_url.compare(0, unix_format.size(), unix_format) == 0) {
+        string path = connection_url.substr(unix_format.size());
+        struct sockaddr_un serv_addr;
+
+        if(path.size() > 0 && path[0] != '/') // Relative paths are relative to the COREM root, like the other results
+            path = constants::getPath() + path;
+        socket_path = path;
+
+        if(path.size() > 0 && path.size() < sizeof(serv_addr.sun_path)) {
+            socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(socket_fd != -1) {
+                memset((void *)&serv_addr, 0, sizeof(serv_addr));
+                serv_addr.sun_family = AF_UNIX;
+                strcpy(serv_addr.sun_path, path.c_str());
+                unlink(path.c_str()); // Remove the socket file of a previous simulation
+                ret_correct = (bind(socket_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) != -1);
+            }
+        } else
+            cout << "Incorrect monitor socket path specified: " << path << endl;
+    } else
+        cout << "Incorrect monitor URL format specified: " << connection_url << ". Expected: " << tcp_any_format << "port_number, " << tcp_local_format << "port_number or " << unix_format << "path." << endl;
+
+    if(ret_correct)
+        ret_correct = (listen(socket_fd, 1) != -1 && fcntl(socket_fd, F_SETFL, O_NONBLOCK) != -1);
+
+    if(ret_correct)
+        cout << "Monitor output listening at " << connection_url << endl;
+    else if(socket_fd != -1) {
+        cout << "Monitor socket " << connection_url << " could not be created. errno: " << errno << "." << endl;
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    return(ret_correct);
+}
+
+void MonitorOutput::acceptViewer(){
+    client_fd = accept(socket_fd, NULL, NULL); // Non-blocking: -1 (EAGAIN) if no viewer is waiting
+    if(client_fd != -1) {
+        if(fcntl(client_fd, F_SETFL, O_NONBLOCK) == -1)
+            closeViewer();
+        else {
+            cout << "\rMonitor viewer connected to " << connection_url << endl;
+            pending_msgs.clear();
+            pending_offset=0;
+        }
+    }
+}
+
+void MonitorOutput::closeViewer(){
+    if(client_fd != -1) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    pending_msgs.clear();
+    pending_offset=0;
+}
+
+// Try to send the pending messages without blocking. Returns true if nothing remains to be sent
+bool MonitorOutput::flushPending(){
+    while(client_fd != -1 && pending_offset < pending_msgs.size()) {
+        ssize_t n_sent = send(client_fd, &pending_msgs[pending_offset], pending_msgs.size()-pending_offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(n_sent > 0)
+            pending_offset += n_sent;
+        else if(n_sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return(false); // The viewer is lagging
+        else if(n_sent == -1 && errno == EINTR)
+            continue;
+        else {
+            cout << "\rMonitor viewer disconnected from " << connection_url << endl;
+            closeViewer();
+        }
+    }
+    return(pending_offset >= pending_msgs.size());
+}
+
+void MonitorOutput::closeConnection(){
+    closeViewer();
+    if(socket_fd != -1) {
+        close(socket_fd);
+        socket_fd = -1;
+        if(!socket_path.empty())
+            unlink(socket_path.c_str());
+    }
+}
+
+//------------------------------------------------------------------------------//
+
+// This function is supposed not to be used
+CImg<double>* MonitorOutput::getOutput(){
+    return (inputImages.size() > 0)? inputImages[0] : NULL;
+}
+
+//------------------------------------------------------------------------------//
+
+bool MonitorOutput::isDummy() {
+    return false;
+    };
@@ -0,0 +1,116 @@
+#ifndef MONITOROUTPUT_H
+#define MONITOROUTPUT_H
+
+/* BeginDocumentation
+ * Name: MonitorOutput
+ *
+ * Description: Special retina module in charge of publishing the retina activity through a local
+ * socket, so that long simulations can be watched from a separate viewer process (for example,
+ * on a machine without X11 displays).
+ * Each input connection of this module is a monitored layer (identified by its port number, that
+ * is, by the order of the Connect commands). Layer frames are downsampled and quantized to 8 bits
+ * and, at every simulation step, the value of the layers at the probe points are also sent.
+ * The probes (Probe_x and Probe_y parameters) take the place of the multimeter samples: they
+ * behave like temporal multimeters of the monitored layers, but the multimeters of the script
+ * (which are recorded by the DisplayManager) are not forwarded through the socket.
+ * The socket is never blocking: the connection of a viewer is checked at each simulation step
+ * and, if the viewer does not consume the data fast enough, new messages are dropped until the
+ * previous ones are completely sent, so the monitoring never slows down the simulation.
+ * In batch mode (see Retina::setBatchSize()) the layers of the first stimulus are published.
+ * Connection URL: 'tcp://passive:port' (any interface), 'tcp://localhost:port' (loopback only)
+ * or 'unix:path' (Unix domain socket, by default 'unix:results/monitor.sock'; relative paths are
+ * relative to the COREM root directory). The socket is created at the first simulation step and
+ * closed (and the socket file removed) when the retina is destroyed.
+ *
+ * Message format (native byte order): 20-byte header with the fields
+ *   uint32 magic (MONITOR_MAGIC), uint16 type, uint16 port, uint32 payload length, double sim. time
+ * followed by the payload:
+ *   frame (MONITOR_FRAME_MSG): uint16 width, uint16 height, float min, float max and
+ *      width*height uint8 values (row by row) in the range [min, max]
+ *   samples (MONITOR_SAMPLES_MSG): uint32 number of probes and a float value for each probe
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ * Author: Richard R. Carrillo. University of Granada. CITIC-UGR. Spain.
+ *
+ * SeeAlso: module, SequenceOutput, StreamingInput
+ */
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "module.h"
+
+using namespace cimg_library;
+using namespace std;
+
+#define MONITOR_MAGIC 0x4D524F43 // "CORM" in little-endian byte order
+#define MONITOR_HEADER_LEN 20
+#define MONITOR_FRAME_MSG 1
+#define MONITOR_SAMPLES_MSG 2
+
+class MonitorOutput:public module{
+protected:
+    // image buffers
+    vector <CImg<double> *> inputImages; // Last input received through each port (monitored layer)
+
+    string connection_url; // URL of the socket: 'tcp://passive:port', 'tcp://localhost:port' or 'unix:path'
+    int socket_fd; // Listening socket file descriptor or -1 if the socket has not been created
+    int client_fd; // Socket of the connected viewer or -1 if no viewer is connected
+    bool connection_opened; // The creation of the listening socket has been attempted (first update)
+    string socket_path; // Absolute path of the Unix domain socket (empty for TCP sockets)
+
+    vector<unsigned char> pending_msgs; // Messages which could not be completely sent yet
+    size_t pending_offset; // Number of bytes of pending_msgs already sent
+    unsigned long num_sent_frames, num_dropped_frames;
+
+    double NextFrameTime; // Simulation time at which the next frame must be published
+
+    // Module parameters
+    double Start_time, End_time; // Simulation time interval during which the layers are published
+    double FramePeriod; // Simulation milliseconds between two consecutive published frames
+    int Downsample; // Each published frame pixel is the average of Downsample x Downsample layer pixels
+    vector<int> Probe_x, Probe_y; // Coordinates of the points whose values are sent at every step
+
+    // Socket handling
+    bool openConnection();
+    void acceptViewer();
+    void closeViewer();
+    bool flushPending();
+    void closeConnection();
+
+    // Message encoding
+    void appendHeader(vector<unsigned char> &msg, uint16_t type, uint16_t port, uint32_t payload_len);
+    void appendFrame(vector<unsigned char> &msg, int port);
+    void appendSamples(vector<unsigned char> &msg, int port);
+
+public:
+    // Constructor, copy, destructor.
+    MonitorOutput(int x=1, int y=1, double temporal_step=1.0, string conn_url="");
+    MonitorOutput(const MonitorOutput& copy);
+    ~MonitorOutput(void);
+
+    // Allocate values and set protected parameters
+    virtual bool allocateValues();
+
+    // These functions are mainly used by setParameters() to set object parameter properties after the object is created
+    bool set_Start_time(double start_time);
+    bool set_End_time(double end_time);
+    bool set_FramePeriod(double period);
+    bool set_Downsample(int factor);
+    bool add_Probe_x(int x);
+    bool add_Probe_y(int y);
+
+    // Get new input
+    virtual void feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port);
+    // Publish the monitored layers
+    virtual void update();
+    // set Parameters
+    virtual int setParameters(vector<double> params, vector<string> paramID);
+    // Get output image (y(k))
+    virtual CImg<double>* getOutput();
+    // Returns false to indicate that this class performs some computations
+    virtual bool isDummy();
+};
+
+#endif // MONITOROUTPUT_H
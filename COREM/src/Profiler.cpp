@@ -0,0 +1,177 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include "Profiler.h"
+
+Profiler::Profiler(void){
+    startTime = chrono::steady_clock::now();
+    traceTruncated = false;
+    stepStart_us = 0.0;
+}
+
+Profiler::Profiler(const Profiler& copy){
+    startTime = copy.startTime;
+    entries = copy.entries;
+    entryIndex = copy.entryIndex;
+    events = copy.events;
+    traceTruncated = copy.traceTruncated;
+    stepStart_us = copy.stepStart_us;
+    stepTimes_us = copy.stepTimes_us;
+}
+
+Profiler::~Profiler(void){
+}
+
+//------------------------------------------------------------------------------//
+
+double Profiler::now(){
+    return(chrono::duration<double, micro>(chrono::steady_clock::now() - startTime).count());
+}
+
+int Profiler::getEntry(const string &moduleID, const string &phase){
+    string key = moduleID + "/" + phase;
+    map<string, int>::iterator it = entryIndex.find(key);
+    if(it != entryIndex.end())
+        return(it->second);
+
+    profile_entry new_entry;
+    new_entry.moduleID = moduleID;
+    new_entry.phase = phase;
+    new_entry.calls = 0;
+    new_entry.total_us = 0.0;
+    new_entry.max_us = 0.0;
+    new_entry.bytes = 0.0;
+    entries.push_back(new_entry);
+    entryIndex[key] = entries.size()-1;
+    return(entries.size()-1);
+}
+
+void Profiler::record(int entry, double start_us, double bytes){
+    double duration_us = now() - start_us;
+    profile_entry &e = entries[entry];
+
+    e.calls++;
+    e.total_us += duration_us;
+    e.bytes += bytes;
+    if(duration_us > e.max_us)
+        e.max_us = duration_us;
+
+    if(events.size() < PROFILER_MAX_TRACE_EVENTS){
+        profile_event ev;
+        ev.entry = entry;
+        ev.start_us = start_us;
+        ev.duration_us = duration_us;
+        events.push_back(ev);
+    } else
+        traceTruncated = true;
+}
+
+//------------------------------------------------------------------------------//
+
+void Profiler::beginStep(){
+    stepStart_us = now();
+}
+
+void Profiler::endStep(){
+    stepTimes_us.push_back(now() - stepStart_us);
+}
+
+//------------------------------------------------------------------------------//
+
+static bool compareTotalTime(const profile_entry &a, const profile_entry &b){
+    return(a.total_us > b.total_us);
+}
+
+void Profiler::printTable(){
+    vector<profile_entry> sorted(entries);
+    double all_us = 0.0;
+
+    sort(sorted.begin(), sorted.end(), compareTotalTime);
+    for(size_t i=0;i<sorted.size();i++)
+        all_us += sorted[i].total_us;
+
+    cout << endl << "Profile of " << stepTimes_us.size() << " simulation steps" << endl;
+    cout << left << setw(28) << "Module" << setw(12) << "Phase" << right << setw(10) << "Calls" << setw(12) << "Total(ms)" << setw(8) << "%" << setw(12) << "Mean(us)" << setw(12) << "Max(us)" << setw(12) << "MB" << setw(10) << "GB/s" << endl;
+    for(size_t i=0;i<sorted.size();i++){
+        const profile_entry &e = sorted[i];
+        if(e.calls == 0)
+            continue;
+        cout << left << setw(28) << e.moduleID.substr(0,27) << setw(12) << e.phase << right << setw(10) << e.calls;
+        cout << fixed << setprecision(2) << setw(12) << e.total_us/1000.0 << setw(8) << ((all_us > 0)? 100.0*e.total_us/all_us : 0.0);
+        cout << setw(12) << ((e.calls > 0)? e.total_us/e.calls : 0.0) << setw(12) << e.max_us;
+        cout << setw(12) << e.bytes/1.0e6 << setw(10) << ((e.total_us > 0)? e.bytes/(e.total_us*1.0e3) : 0.0) << endl;
+        cout.unsetf(ios::fixed);
+    }
+
+    if(stepTimes_us.size() > 0){
+        double total = 0.0, max_step = 0.0;
+        for(size_t s=0;s<stepTimes_us.size();s++){
+            total += stepTimes_us[s];
+            max_step = max(max_step, stepTimes_us[s]);
+        }
+        cout << fixed << setprecision(2) << "Step wall time: mean " << total/stepTimes_us.size() << " us, max " << max_step << " us, total " << total/1000.0 << " ms" << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+string Profiler::escapeJSON(const string &text){
+    string escaped;
+    for(size_t i=0;i<text.size();i++){
+        unsigned char ch = text[i];
+        if(ch == '"' || ch == '\\'){
+            escaped += '\\';
+            escaped += ch;
+        }else if(ch < 0x20){ // Control characters
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", ch);
+            escaped += code;
+        }else
+            escaped += ch;
+    }
+    return(escaped);
+}
+
+bool Profiler::saveJSON(const string &filename){
+    ofstream out(filename.c_str());
+    if(!out.is_open()){
+        cout << "Unable to create profile file: " << filename << endl;
+        return(false);
+    }
+
+    out << "{\n  \"steps\": " << stepTimes_us.size() << ",\n  \"step_wall_time_us\": [";
+    for(size_t s=0;s<stepTimes_us.size();s++)
+        out << ((s>0)? ",":"") << stepTimes_us[s];
+    out << "],\n  \"modules\": [\n";
+    for(size_t i=0;i<entries.size();i++){
+        const profile_entry &e = entries[i];
+        out << "    {\"module\": \"" << escapeJSON(e.moduleID) << "\", \"phase\": \"" << escapeJSON(e.phase) << "\", \"calls\": " << e.calls;
+        out << ", \"total_us\": " << e.total_us << ", \"max_us\": " << e.max_us << ", \"bytes\": " << e.bytes << "}";
+        out << ((i+1<entries.size())? ",\n":"\n");
+    }
+    out << "  ]\n}\n";
+    return(out.good());
+}
+
+bool Profiler::saveChromeTrace(const string &filename){
+    ofstream out(filename.c_str());
+    if(!out.is_open()){
+        cout << "Unable to create trace file: " << filename << endl;
+        return(false);
+    }
+
+    if(traceTruncated)
+        cout << "Warning: only the first " << PROFILER_MAX_TRACE_EVENTS << " profiled calls are saved in " << filename << endl;
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for(size_t i=0;i<events.size();i++){
+        const profile_event &ev = events[i];
+        const profile_entry &e = entries[ev.entry];
+        out << "{\"name\": \"" << escapeJSON(e.moduleID) << "\", \"cat\": \"" << escapeJSON(e.phase) << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0";
+        out << fixed << setprecision(3) << ", \"ts\": " << ev.start_us << ", \"dur\": " << ev.duration_us << "}";
+        out << ((i+1<events.size())? ",\n":"\n");
+    }
+    out << "]}\n";
+    return(out.good());
+}
@@ -0,0 +1,90 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/* BeginDocumentation
+ * Name: Profiler
+ *
+ * Description: Instrumentation of the simulation hot path. For each module ID and phase
+ * (feedInput, update, display...) it accumulates the number of calls, the wall time
+ * (total and maximum per call, which is also the maximum per simulation step since each
+ * module is called once per step) and an estimation of the memory bytes touched (images
+ * read and written). The wall time of each simulation step is also recorded.
+ * At the end of a run the statistics can be printed as a table sorted by total time and
+ * saved as JSON. Each timed call can also be saved as a Chrome trace (chrome://tracing or
+ * Perfetto) for a flame-graph style inspection.
+ * The Retina and RetinaInterface objects only profile their calls when a Profiler object
+ * is set, so the simulation is not slowed down otherwise.
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ *
+ * SeeAlso: Retina, RetinaInterface
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+using namespace std;
+
+// Maximum number of calls saved for the Chrome trace (the statistics are always computed)
+#define PROFILER_MAX_TRACE_EVENTS 1000000
+
+// Statistics of a (module ID, phase) pair
+struct profile_entry {
+    string moduleID;
+    string phase;
+    unsigned long calls;
+    double total_us;
+    double max_us;
+    double bytes;
+};
+
+// Timed call saved for the Chrome trace
+struct profile_event {
+    int entry;
+    double start_us;
+    double duration_us;
+};
+
+class Profiler{
+protected:
+    chrono::steady_clock::time_point startTime; // Origin of the trace timestamps
+    vector<profile_entry> entries;
+    map<string, int> entryIndex; // Index of each "moduleID/phase" in entries
+    vector<profile_event> events;
+    bool traceTruncated;
+
+    // Per-step wall time
+    double stepStart_us;
+    vector<double> stepTimes_us;
+
+    // Escape a string (module IDs come from the retina script) for a JSON string literal
+    static string escapeJSON(const string &text);
+
+public:
+    // Constructor, copy, destructor.
+    Profiler(void);
+    Profiler(const Profiler& copy);
+    ~Profiler(void);
+
+    // Microseconds elapsed since the profiler creation
+    double now();
+
+    // Get the index of a (module ID, phase) pair, it is created if it does not exist
+    int getEntry(const string &moduleID, const string &phase);
+    // Record a call which started at start_us (obtained with now()) and touched the specified bytes
+    void record(int entry, double start_us, double bytes);
+
+    // Delimit a simulation step
+    void beginStep();
+    void endStep();
+
+    // Results
+    void printTable();
+    bool saveJSON(const string &filename);
+    bool saveChromeTrace(const string &filename);
+};
+
+#endif // PROFILER_H
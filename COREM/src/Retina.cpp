@@ -6,10 +6,14 @@ Retina::Retina(int x, int y, double temporal_step){
     step = temporal_step;
     sizeX=x;
     sizeY=y;
+    batchSize = 1;
     pixelsPerDegree = 1.0;
     inputType = -1; // Invalid retina input type
+    CurrentTrial = 0;
 
     verbose = false;
+    fastMath = false;
+    profiler = NULL;
 
     // The fist element of modules (modules[0]) is a dummy Input module used in case a particular Input action is not
     // specified in the script (in this case if a new Input module is inserted the first one is replaced)
@@ -29,18 +33,25 @@ Retina::Retina(int x, int y, double temporal_step){
     ch2= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
     ch3= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
     rods= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
-    X_mat= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
-    Y_mat= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
-    Z_mat= new CImg <double>(sizeY, sizeX, 1, 1, 0.0);
+
+    connectionsCompiled = false;
+    inputConverted = false;
+    convertedInput = NULL;
+    convertedInputVersion = 0;
+    channelsVersion = 0;
+    stepCount = 0;
 }
 
 Retina::Retina(const Retina& copy){
     step = copy.step;
     sizeX= copy.sizeX;
     sizeY= copy.sizeY;
+    batchSize = copy.batchSize;
     pixelsPerDegree = copy.pixelsPerDegree;
     inputType = copy.inputType;
     verbose = copy.verbose;
+    fastMath = copy.fastMath;
+    profiler = copy.profiler;
 
     modules= copy.modules;
 
@@ -53,9 +64,13 @@ Retina::Retina(const Retina& copy){
     ch2= new CImg <double>(*copy.ch2);
     ch3= new CImg <double>(*copy.ch3);
     rods= new CImg <double>(*copy.rods);
-    X_mat= new CImg <double>(*copy.X_mat);
-    Y_mat= new CImg <double>(*copy.Y_mat);
-    Z_mat= new CImg <double>(*copy.Z_mat);
+
+    connectionsCompiled = false; // Compiled again on the first feedInput()
+    inputConverted = false;
+    convertedInput = NULL;
+    convertedInputVersion = 0;
+    channelsVersion = 0;
+    stepCount = 0;
 }
 
 Retina::~Retina(void){
@@ -76,19 +91,18 @@ Retina::~Retina(void){
     delete ch2;
     delete ch3;
     delete rods;
-    delete X_mat;
-    delete Y_mat;
-    delete Z_mat;
 }
 
 void Retina::reset(int x,int y,double temporal_step){
     step = temporal_step;
     sizeX=x;
     sizeY=y;
+    batchSize = 1;
     pixelsPerDegree = 1.0;
     inputType = 0;
 
     verbose = false;
+    fastMath = false;
 
     while(!modules.empty()) { // Destroy all the Retina modules and empty modules vector
         delete modules.back();
@@ -109,9 +123,10 @@ void Retina::reset(int x,int y,double temporal_step){
     ch2->fill(0.0);
     ch3->fill(0.0);
     rods->fill(0.0);
-    X_mat->fill(0.0);
-    Y_mat->fill(0.0);
-    Z_mat->fill(0.0);
+
+    connectionsCompiled = false;
+    inputConverted = false;
+    moduleReachable.clear();
 }
 
 //------------------------------------------------------------------------------//
@@ -136,6 +151,20 @@ bool Retina::setSizeY(int y){
     return(ret_correct);
 }
 
+bool Retina::setBatchSize(int b){
+    bool ret_correct;
+    if (b>0){
+        batchSize = b;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+int Retina::getBatchSize(){
+    return batchSize;
+}
+
 bool Retina::set_step(double temporal_step) {
     bool ret_correct;
     if (temporal_step>0){
@@ -177,6 +206,36 @@ bool Retina::setVerbosity(bool verbose_flag){
     return(true);
 }
 
+void Retina::setFastMath(bool fast_flag){
+    fastMath = fast_flag;
+}
+
+bool Retina::getFastMath(){
+    return(fastMath);
+}
+
+void Retina::setProfiler(Profiler *prof){
+    profiler = prof;
+    feedProfEntries.clear();
+    updateProfEntries.clear();
+}
+
+Profiler *Retina::getProfiler(){
+    return profiler;
+}
+
+// The profiler entries are looked up once (modules cannot be added during the simulation)
+void Retina::createProfileEntries(){
+    feedProfEntries.clear();
+    updateProfEntries.clear();
+    for(size_t i=0;i<modules.size();i++){
+        feedProfEntries.push_back(profiler->getEntry(modules[i]->getModuleID(), "feedInput"));
+        updateProfEntries.push_back(profiler->getEntry(modules[i]->getModuleID(), "update"));
+    }
+    inputProfEntry = profiler->getEntry("Input", "generate");
+    colorProfEntry = profiler->getEntry("Input", "color");
+}
+
 bool Retina::setSimTotalTrials(double r){
     bool ret_correct;
     if(r >= 0) {
@@ -228,43 +287,54 @@ bool Retina::allocateValues(){
     // of modules and retina
     modules[0]->setSizeX(sizeX);
     modules[0]->setSizeY(sizeY);
-    modules[0]->allocateValues(); // Input module may determine a new size after allocateValues() call
+    modules[0]->setFastMath(fastMath);
+    modules[0]->setBatchSize(batchSize);
+    ret_correct = modules[0]->allocateValues(); // Input module may determine a new size after allocateValues() call
     sizeX=modules[0]->getSizeX();
     sizeY=modules[0]->getSizeY();
-    
-    ret_correct = true;
+
     for (size_t i=1;i<modules.size();i++){ // For all modules except the Input one:
         module* m = modules[i];
-        m->setSizeX(sizeX);
-        m->setSizeY(sizeY);
+        if(!isReachable(i)) // Its output is not used
+            continue;
+        // Size of the module grid
+        m->setSizeX((sizeX + m->getDownsample() - 1)/m->getDownsample());
+        m->setSizeY((sizeY + m->getDownsample() - 1)/m->getDownsample());
+        m->setFastMath(fastMath);
+        m->setBatchSize(batchSize);
         ret_correct = ret_correct && m->allocateValues();
     }
+    if(inputType == 2 && WN != NULL)
+        WN->setBatchSize(batchSize);
 
     if(verbose) {
         cout << "Allocating "<< (getNumberModules()-1) << " retinal modules." << endl;
         cout << "sizeX (height) = "<< sizeX << endl;
         cout << "sizeY (width)  = "<< sizeY << endl;
+        if(batchSize > 1)
+            cout << "Batch size = "<< batchSize << " stimuli" << endl;
         cout << "Temporal step = "<< step << " ms" << endl;
     }
     
     // Set current simulation time to 0 (this value is updated when feedInput() method is excuted)
     simTime = 0;
+    stepCount = 0;
 
     // Since Retina-class internal images are allocated in the constructor (and freed in the destructor)
     // they are not allocated here, just resized to match the last specified sizeX and sizeY
-    output->assign(sizeY, sizeX, 1, 1, 0.0);
-    accumulator->assign(sizeY, sizeX, 1, 1, 0.0);
-
-    RGBred->assign(sizeY, sizeX, 1, 1, 0.0);
-    RGBgreen->assign(sizeY, sizeX, 1, 1, 0.0);
-    RGBblue->assign(sizeY, sizeX, 1, 1, 0.0);
-    ch1->assign(sizeY, sizeX, 1, 1, 0.0);
-    ch2->assign(sizeY, sizeX, 1, 1, 0.0);
-    ch3->assign(sizeY, sizeX, 1, 1, 0.0);
-    rods->assign(sizeY, sizeX, 1, 1, 0.0);
-    X_mat->assign(sizeY, sizeX, 1, 1, 0.0);
-    Y_mat->assign(sizeY, sizeX, 1, 1, 0.0);
-    Z_mat->assign(sizeY, sizeX, 1, 1, 0.0);
+    output->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    accumulator->assign(sizeY, sizeX, batchSize, 1, 0.0);
+
+    RGBred->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    RGBgreen->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    RGBblue->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    ch1->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    ch2->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    ch3->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    rods->assign(sizeY, sizeX, batchSize, 1, 0.0);
+
+    connectionsCompiled = false;
+    inputConverted = false;
     
     return(ret_correct);
 }
@@ -274,6 +344,14 @@ bool Retina::allocateValues(){
 
 CImg<double> *Retina::feedInput(int sim_time){
     CImg <double> *input;
+    double prof_start = 0.0;
+    double image_bytes = (double)accumulator->size()*sizeof(double);
+
+    if(profiler){
+        if(feedProfEntries.size() != modules.size())
+            createProfileEntries();
+        prof_start = profiler->now();
+    }
 
     // Update Retina current simulation time from InterfaceNEST current simulation time
     simTime = sim_time;
@@ -309,123 +387,553 @@ CImg<double> *Retina::feedInput(int sim_time){
         break;
     }
 
+    if(profiler)
+        profiler->record(inputProfEntry, prof_start, (input != NULL)? (double)input->size()*sizeof(double) : 0.0);
+
     if(input != NULL) { // We have input, so simulation can continue
-        if(input->size() == (size_t)sizeX*(size_t)sizeY){
-            // Separate color channels
-            // cimg_forXY(img,x,y) is equivalent to cimg_forY(img,y) cimg_forX(img,x).
-            // cimg_forX(img,x) is equivalent to for(int x=0;x<img.width();++x)
-            cimg_forXY(*input,x,y) {
-                (*RGBred)(x,y,0,0) = (*input)(x,y,0,0),    // Red component of image sent to imgR
-                (*RGBgreen)(x,y,0,0) = (*input)(x,y,0,0),    // Green component of image sent to imgG
-                (*RGBblue)(x,y,0,0) = (*input)(x,y,0,0);    // Blue component of image sent to imgB
+        if(!connectionsCompiled)
+            compileConnections();
+
+        // Convert the input into the channels used if the input frame has changed
+        unsigned long input_version = getInputVersion();
+        if(!inputConverted || input != convertedInput || input_version != convertedInputVersion){
+            if(profiler)
+                prof_start = profiler->now();
+
+            convertInputChannels(*input);
+            channelsVersion++;
+            convertedInput = input;
+            convertedInputVersion = input_version;
+            inputConverted = true;
+
+            if(profiler){ // Input and channel images written
+                int n_channels = 0;
+                for(int c=0;c<NUM_INPUT_CHANNELS;c++)
+                    if(channelUsed[c] && c != ZEROS_CHANNEL)
+                        n_channels++;
+                profiler->record(colorProfEntry, prof_start, (double)input->size()*sizeof(double) + n_channels*image_bytes);
             }
-        }else{
-           // Separate color channels
-           cimg_forXY(*input,x,y) {
-               (*RGBred)(x,y,0,0) = (*input)(x,y,0,0),    // Red component of image sent to imgR
-               (*RGBgreen)(x,y,0,0) = (*input)(x,y,0,1),    // Green component of image sent to imgG
-               (*RGBblue)(x,y,0,0) = (*input)(x,y,0,2);    // Blue component of image sent to imgB
-           }
         }
-        // Hunt-Pointer-Estévez (HPE) transform
-        // sRGB --> XYZ
-        *X_mat = 0.4124564*(*RGBblue) + 0.3575761*(*RGBgreen) + 0.1804375*(*RGBred);
-        *Y_mat = 0.2126729*(*RGBblue) + 0.7151522*(*RGBgreen) + 0.0721750*(*RGBred);
-        *Z_mat = 0.0193339*(*RGBblue) + 0.1191920*(*RGBgreen) + 0.9503041*(*RGBred);
-
-        // XYZ --> LMS
-        *ch1 = 0.38971*(*X_mat) + 0.68898*(*Y_mat) - 0.07868*(*Z_mat);
-        *ch2 = -0.22981*(*X_mat) + 1.1834*(*Y_mat) + 0.04641*(*Z_mat);
-        *ch3 = (*Z_mat);
-
-        *rods = (*ch1 + *ch2 + *ch3)/3;
 
         for (size_t i=0;i<modules.size();i++){ // Feed the input of all modules (including Input module although it is not necessart)
 
             module* neuron = modules[i];
+            vector<compiled_port> &ports = compiledPorts[i];
+            size_t n_sources = 0;
 
-            // port search
-            for (int o=0;o<neuron->getSizeID();o++){ // For all the module input connections:
+            if(!isReachable(i)) // Its output is not used
+                continue;
 
-                vector <string> l = neuron->getID(o);
-                vector <int> p = neuron->getOperation(o);
+            // Modules with an update period are only fed in their update steps
+            skipUpdate[i] = false;
+            if(!isUpdateStep(i)){
+                skipUpdate[i] = true;
+                continue;
+            }
 
-                //image input
-                const char * cellName = l[0].c_str(); // ID of the first port of current connection
-
-                if(strcmp(cellName,"L_cones")==0){
-                        *accumulator = *ch3;
-                }else if(strcmp(cellName,"M_cones")==0){
-                        *accumulator = *ch2;
-                }else if(strcmp(cellName,"S_cones")==0){
-                        *accumulator = *ch1;
-                }else if(strcmp(cellName,"rods")==0){
-                        *accumulator = *rods;
-                // Inputs mainly used for testing
-                }else if(strcmp(cellName,"red_channel")==0){
-                        *accumulator = *RGBred;
-                }else if(strcmp(cellName,"green_channel")==0){
-                        *accumulator = *RGBgreen;
-                }else if(strcmp(cellName,"blue_channel")==0){
-                        *accumulator = *RGBblue;
-                }else if(strcmp(cellName,"zeros")==0){
-                        accumulator->fill(0.0);
-                }else{
+            // Skip stateless modules whose inputs have not changed: their output is still valid
+            if(neuron->isStateless()){
+                vector<unsigned long> versions;
+                getInputVersions(i, versions);
+                statelessSteps[i]++;
+                if(moduleFed[i] && versions == lastInputVersions[i]){
+                    skipUpdate[i] = true;
+                    skippedUpdates[i]++;
+                    continue;
+                }
+                lastInputVersions[i].swap(versions);
+                moduleFed[i] = true;
+            }
 
-                // other inputs rather than cones or rods
+            if(profiler)
+                prof_start = profiler->now();
 
-                    //search for the first image
-                    for (size_t m=0;m<modules.size();m++){ // Start from module 0: We consider Input module as possible source here although it it not necessary
-                        module *n = modules[m];
-                        string cellName1 = l[0];
-                        string cellName2 = n->getModuleID();
-                        if (cellName1.compare(cellName2)==0){
-                            *accumulator = *(n->getOutput());
-                            break;
-                        }
-                    }
-                }
+            int factor = neuron->getDownsample();
+            for (size_t o=0;o<ports.size();o++){ // For all the module input connections:
+                compiled_port &port = ports[o];
+
+                //image input
+                if(port.channel == ZEROS_CHANNEL)
+                    accumulator->assign((sizeY + factor - 1)/factor, (sizeX + factor - 1)/factor, batchSize, 1, 0.0);
+                else if(port.channel != NO_INPUT_CHANNEL)
+                    *accumulator = *resampleSource(getChannelImage(port.channel), 1, factor);
+                else if(port.first != NULL) // other inputs rather than cones or rods
+                    *accumulator = *resampleSource(getSourceOutput(port.first, port.firstIndex), port.firstDownsample, factor);
 
                 // Accumulate input from other ports (perform other operations), even if the first port is a predefined input
-                for (size_t k=1;k<l.size();k++){
-
-                    for (size_t m=0;m<modules.size();m++){ // Search for source in all modules
-                        module* n = modules[m];
-                        string cellName1 = l[k];
-                        string cellName2 = n->getModuleID();
-
-                        if (cellName1.compare(cellName2)==0){
-
-                           if (p[k-1]==0){
-                                *accumulator += *(n->getOutput());
-                            }else if(p[k-1]==1){
-                                *accumulator -= *(n->getOutput());
-                            }else{
-                               *accumulator /= *(n->getOutput());
-                           }
-                           break;
-                        }
+                for (size_t k=0;k<port.others.size();k++){
+                    compiled_source &src = port.others[k];
+                    if(src.source == NULL)
+                        continue;
+
+                    const CImg<double> *source_output = resampleSource(getSourceOutput(src.source, src.index), src.downsample, factor);
+                    if (src.operation==0){
+                        *accumulator += *source_output;
+                    }else if(src.operation==1){
+                        *accumulator -= *source_output;
+                    }else{
+                        *accumulator /= *source_output;
                     }
                 }
 
-                if (neuron->getTypeSynapse(o)==0)
-                    neuron->feedInput(sim_time, *accumulator, true, o);
-                else
-                    neuron->feedInput(sim_time, *accumulator, false, o);
+                neuron->feedInput(sim_time, *accumulator, port.isCurrent, o);
+                n_sources += port.others.size() + 1;
             }
+
+            // Each source is read and accumulated, and the accumulator is copied into the module
+            if(profiler && ports.size() > 0)
+                profiler->record(feedProfEntries[i], prof_start, (2.0*n_sources + 2.0*ports.size())*image_bytes);
         }
     }
     return input;
 }
 
 
+//------------------------------------------------------------------------------//
+
+// Resolve the source IDs of all the module connections. The first source of a connection can
+// be an input channel or a module (the first module found with that ID, including Input), the
+// rest of sources can only be modules. Sources which are not found are ignored.
+void Retina::compileConnections(){
+    compiledPorts.assign(modules.size(), vector<compiled_port>());
+    for(int c=0;c<NUM_INPUT_CHANNELS;c++)
+        channelUsed[c] = false;
+
+    for(size_t i=0;i<modules.size();i++){
+        module *neuron = modules[i];
+
+        for(int o=0;o<neuron->getSizeID();o++){
+            vector <string> l = neuron->getID(o);
+            vector <int> p = neuron->getOperation(o);
+            compiled_port port;
+            const char *cellName = l[0].c_str(); // ID of the first port of current connection
+
+            port.first = NULL;
+            port.firstIndex = -1;
+            port.firstDownsample = 1;
+            if(strcmp(cellName,"L_cones")==0)
+                port.channel = L_CONES_CHANNEL;
+            else if(strcmp(cellName,"M_cones")==0)
+                port.channel = M_CONES_CHANNEL;
+            else if(strcmp(cellName,"S_cones")==0)
+                port.channel = S_CONES_CHANNEL;
+            else if(strcmp(cellName,"rods")==0)
+                port.channel = RODS_CHANNEL;
+            else if(strcmp(cellName,"red_channel")==0) // Inputs mainly used for testing
+                port.channel = RED_CHANNEL;
+            else if(strcmp(cellName,"green_channel")==0)
+                port.channel = GREEN_CHANNEL;
+            else if(strcmp(cellName,"blue_channel")==0)
+                port.channel = BLUE_CHANNEL;
+            else if(strcmp(cellName,"zeros")==0)
+                port.channel = ZEROS_CHANNEL;
+            else{
+                port.channel = NO_INPUT_CHANNEL;
+                for(size_t m=0;m<modules.size() && port.first == NULL;m++)
+                    if(l[0].compare(modules[m]->getModuleID())==0){
+                        port.first = modules[m];
+                        port.firstIndex = computingModuleIndex(m);
+                        port.firstDownsample = modules[port.firstIndex]->getDownsample();
+                    }
+            }
+            if(port.channel != NO_INPUT_CHANNEL)
+                channelUsed[port.channel] = true;
+
+            for(size_t k=1;k<l.size();k++){
+                compiled_source src;
+                src.source = NULL;
+                src.index = -1;
+                src.downsample = 1;
+                src.operation = p[k-1];
+                for(size_t m=0;m<modules.size() && src.source == NULL;m++)
+                    if(l[k].compare(modules[m]->getModuleID())==0){
+                        src.source = modules[m];
+                        src.index = computingModuleIndex(m);
+                        src.downsample = modules[src.index]->getDownsample();
+                    }
+                port.others.push_back(src);
+            }
+
+            port.isCurrent = (neuron->getTypeSynapse(o)==0);
+            compiledPorts[i].push_back(port);
+        }
+    }
+
+    connectionsCompiled = true;
+    inputConverted = false; // Used channels may have changed
+
+    lastInputVersions.assign(modules.size(), vector<unsigned long>());
+    moduleFed.assign(modules.size(), false);
+    skipUpdate.assign(modules.size(), false);
+    statelessSteps.resize(modules.size(), 0);
+    skippedUpdates.resize(modules.size(), 0);
+
+    previousOutputs.assign(modules.size(), CImg<double>());
+    interpolatedOutputs.assign(modules.size(), CImg<double>());
+    lastUpdateSteps.assign(modules.size(), -1);
+    interpolatedSteps.assign(modules.size(), -1);
+}
+
+// Image of a source resampled to the grid of the module fed (the image itself if the grids are the same)
+const CImg<double> *Retina::resampleSource(const CImg<double> *image, int src_factor, int dst_factor){
+    if(src_factor == dst_factor)
+        return(image);
+    resampleImage(*image, src_factor, resampledSource, dst_factor, sizeY, sizeX);
+    return(&resampledSource);
+}
+
+void Retina::resampleImage(const CImg<double> &src, int src_factor, CImg<double> &dst, int dst_factor, int width, int height){
+    int src_w = src.width(), src_h = src.height();
+    int dst_w = (width + dst_factor - 1)/dst_factor, dst_h = (height + dst_factor - 1)/dst_factor;
+    int depth = src.depth(); // Stimuli of a batch: each slice is resampled independently
+
+    dst.assign(dst_w, dst_h, depth, 1);
+
+    if(dst_factor == src_factor)
+        dst = src;
+    else if(dst_factor > src_factor){
+        // Area average: destination column (row) which contains the center of each source column (row),
+        // number of source columns (rows) of each destination column (row) and first source row of each
+        // destination row (the rows of the destination are computed in parallel)
+        vector<int> column(src_w), row_start(dst_h+1, src_h);
+        vector<double> column_count(dst_w, 0.0), row_count(dst_h, 0.0);
+        for(int x=0;x<src_w;x++){
+            column[x] = min((int)((x*src_factor + 0.5*(src_factor - 1))/dst_factor), dst_w - 1);
+            column_count[column[x]] += 1.0;
+        }
+        for(int y=src_h-1;y>=0;y--){
+            int row = min((int)((y*src_factor + 0.5*(src_factor - 1))/dst_factor), dst_h - 1);
+            row_count[row] += 1.0;
+            for(int r=row;r>=0 && row_start[r] > y;r--)
+                row_start[r] = y;
+        }
+
+        for(int z=0;z<depth;z++){
+            const double *in = src.data(0,0,z);
+            double *out = dst.data(0,0,z);
+            #pragma omp parallel for if((long)src_w*src_h >= 32768)
+            for(int y=0;y<dst_h;y++){
+                double *out_row = out + (long)y*dst_w;
+                for(int x=0;x<dst_w;x++)
+                    out_row[x] = 0.0;
+                for(int sy=row_start[y];sy<row_start[y+1];sy++){
+                    const double *in_row = in + (long)sy*src_w;
+                    for(int x=0;x<src_w;x++)
+                        out_row[column[x]] += in_row[x];
+                }
+                for(int x=0;x<dst_w;x++)
+                    out_row[x] = (column_count[x]*row_count[y] > 0.0)? out_row[x]/(column_count[x]*row_count[y]) : 0.0;
+            }
+        }
+    }else{
+        // Bilinear interpolation at the center of each destination pixel (constant extension at the boundaries)
+        vector<int> column0(dst_w), column1(dst_w), row0(dst_h), row1(dst_h);
+        vector<double> column_weight(dst_w), row_weight(dst_h);
+        for(int x=0;x<dst_w;x++){
+            double u = (x*dst_factor + 0.5*(dst_factor - 1) - 0.5*(src_factor - 1))/src_factor;
+            u = max(0.0, min(u, (double)(src_w - 1)));
+            column0[x] = (int)u;
+            column1[x] = min(column0[x] + 1, src_w - 1);
+            column_weight[x] = u - column0[x];
+        }
+        for(int y=0;y<dst_h;y++){
+            double v = (y*dst_factor + 0.5*(dst_factor - 1) - 0.5*(src_factor - 1))/src_factor;
+            v = max(0.0, min(v, (double)(src_h - 1)));
+            row0[y] = (int)v;
+            row1[y] = min(row0[y] + 1, src_h - 1);
+            row_weight[y] = v - row0[y];
+        }
+
+        for(int z=0;z<depth;z++){
+            const double *in = src.data(0,0,z);
+            double *out = dst.data(0,0,z);
+            #pragma omp parallel for if((long)dst_w*dst_h >= 32768)
+            for(int y=0;y<dst_h;y++){
+                const double *in_row0 = in + (long)row0[y]*src_w, *in_row1 = in + (long)row1[y]*src_w;
+                double *out_row = out + (long)y*dst_w;
+                double wy = row_weight[y];
+                for(int x=0;x<dst_w;x++){
+                    double wx = column_weight[x];
+                    double top = in_row0[column0[x]] + wx*(in_row0[column1[x]] - in_row0[column0[x]]);
+                    double bottom = in_row1[column0[x]] + wx*(in_row1[column1[x]] - in_row1[column0[x]]);
+                    out_row[x] = top + wy*(bottom - top);
+                }
+            }
+        }
+    }
+}
+
+// Position of the module which computes the output of a module: the target of an alias or the module itself
+int Retina::computingModuleIndex(size_t mod_ind){
+    ModuleAlias *alias = dynamic_cast<ModuleAlias*>(modules[mod_ind]);
+    int index = (int)mod_ind;
+
+    if(alias != NULL)
+        for(size_t m=0;m<modules.size();m++)
+            if(modules[m] == alias->getTarget())
+                index = (int)m;
+    return(index);
+}
+
+bool Retina::isUpdateStep(size_t mod_ind){
+    return(stepCount % modules[mod_ind]->getUpdatePeriod() == 0);
+}
+
+bool Retina::interpolatesOutput(size_t mod_ind){
+    return(modules[mod_ind]->getUpdatePeriod() > 1 && modules[mod_ind]->getInterpolateOutput());
+}
+
+// Output of a source module read by the modules connected to it. If the module interpolates its output,
+// the output computed in its last update (at step k) is the value for step k+N, and the value for the
+// step k+j is interpolated between the output at step k and this one
+CImg<double> *Retina::getSourceOutput(module *source, int mod_ind){
+    CImg<double> *source_output = source->getOutput();
+
+    if(mod_ind >= 0 && interpolatesOutput(mod_ind) && lastUpdateSteps[mod_ind] >= 0){
+        long steps_since_update = (long)stepCount - lastUpdateSteps[mod_ind];
+        int period = modules[mod_ind]->getUpdatePeriod();
+
+        if(steps_since_update < period && previousOutputs[mod_ind].size() == source_output->size()){
+            CImg<double> &interpolated = interpolatedOutputs[mod_ind];
+
+            if(interpolatedSteps[mod_ind] != (long)stepCount){
+                const CImg<double> &previous = previousOutputs[mod_ind];
+                double weight = (double)steps_since_update/period;
+                const double *prev = previous.data(), *cur = source_output->data();
+                long n_pixels = (long)source_output->size();
+
+                interpolated.assign(source_output->width(), source_output->height(), source_output->depth(), source_output->spectrum());
+                double *out = interpolated.data();
+                #pragma omp parallel for if(n_pixels >= 32768)
+                for(long p=0;p<n_pixels;p++)
+                    out[p] = prev[p] + weight*(cur[p] - prev[p]);
+                interpolatedSteps[mod_ind] = (long)stepCount;
+            }
+            source_output = &interpolated;
+        }
+    }
+    return(source_output);
+}
+
+// Versions of the sources of all the input ports of a module
+void Retina::getInputVersions(size_t mod_ind, vector<unsigned long> &versions){
+    vector<compiled_port> &ports = compiledPorts[mod_ind];
+
+    for(size_t o=0;o<ports.size();o++){
+        compiled_port &port = ports[o];
+
+        if(port.channel == ZEROS_CHANNEL)
+            versions.push_back(0);
+        else if(port.channel != NO_INPUT_CHANNEL)
+            versions.push_back(channelsVersion);
+        else
+            versions.push_back((port.first != NULL)? port.first->getOutputVersion() : 0);
+
+        for(size_t k=0;k<port.others.size();k++)
+            versions.push_back((port.others[k].source != NULL)? port.others[k].source->getOutputVersion() : 0);
+    }
+}
+
+CImg<double> *Retina::getChannelImage(int channel){
+    CImg<double> *image;
+
+    switch(channel){
+    case L_CONES_CHANNEL: image = ch3; break;
+    case M_CONES_CHANNEL: image = ch2; break;
+    case S_CONES_CHANNEL: image = ch1; break;
+    case RODS_CHANNEL: image = rods; break;
+    case RED_CHANNEL: image = RGBred; break;
+    case GREEN_CHANNEL: image = RGBgreen; break;
+    case BLUE_CHANNEL: image = RGBblue; break;
+    default: image = NULL; break;
+    }
+    return(image);
+}
+
+//------------------------------------------------------------------------------//
+
+// Version of the current input frame: it changes when the input image changes
+unsigned long Retina::getInputVersion(){
+    unsigned long version;
+
+    switch(inputType){
+    case 0: version = modules[0]->getOutputVersion(); break;
+    case 1: version = g->getFrameVersion(); break;
+    case 2: version = WN->getFrameVersion(); break;
+    case 3: version = imp->getFrameVersion(); break;
+    case 4: version = fg->getFrameVersion(); break;
+    default: version = 0; break;
+    }
+    return(version);
+}
+
+// Gain of a color channel (0: red, 1: green, 2: blue) with respect to the input image. Generators
+// of achromatic stimuli produce a single luminance channel and each color channel is a scaled copy
+double Retina::getInputGain(int channel){
+    double gain;
+
+    switch(inputType){
+    case 1: gain = g->getChannelGain(channel); break;
+    case 4: gain = fg->getChannelGain(channel); break;
+    default: gain = 1.0; break;
+    }
+    return(gain);
+}
+
+// Single pass over the input computing only the channels used by the connections:
+// Hunt-Pointer-Estévez (HPE) transform, sRGB --> XYZ --> LMS, and rods (mean of LMS).
+// In batch mode an input with one slice is converted once and copied to all the stimuli
+void Retina::convertInputChannels(const CImg<double> &input){
+    long layer_size = (long)sizeX*sizeY;
+    int n_stimuli = (input.depth() >= batchSize)? batchSize : 1;
+    long n_pixels = layer_size*n_stimuli;
+    long plane = layer_size*input.depth(); // Size of one color channel of the input
+
+    // One channel: every color channel is the input scaled by its gain
+    if(input.size() == (size_t)plane)
+        convertLuminanceInput(input, n_pixels);
+    else
+        convertColorInput(input, n_pixels, plane);
+
+    if(n_stimuli < batchSize){
+        for(int c=0;c<NUM_INPUT_CHANNELS;c++){
+            CImg<double> *image = getChannelImage(c);
+            if(!channelUsed[c] || image == NULL)
+                continue;
+            for(int b=1;b<batchSize;b++)
+                memcpy(image->data() + b*layer_size, image->data(), layer_size*sizeof(double));
+        }
+    }
+}
+
+void Retina::convertColorInput(const CImg<double> &input, long n_pixels, long plane){
+    const double *in_r = input.data();
+    const double *in_g = in_r + plane;
+    const double *in_b = in_r + 2*plane;
+
+    double *red = (channelUsed[RED_CHANNEL])? RGBred->data() : NULL;
+    double *green = (channelUsed[GREEN_CHANNEL])? RGBgreen->data() : NULL;
+    double *blue = (channelUsed[BLUE_CHANNEL])? RGBblue->data() : NULL;
+    double *L = (channelUsed[L_CONES_CHANNEL])? ch3->data() : NULL;
+    double *M = (channelUsed[M_CONES_CHANNEL])? ch2->data() : NULL;
+    double *S = (channelUsed[S_CONES_CHANNEL])? ch1->data() : NULL;
+    double *rod = (channelUsed[RODS_CHANNEL])? rods->data() : NULL;
+    bool lms_used = (L != NULL || M != NULL || S != NULL || rod != NULL);
+
+    #pragma omp parallel for if(n_pixels >= 32768)
+    for(long i=0;i<n_pixels;i++){
+        double R = in_r[i], G = in_g[i], B = in_b[i];
+
+        if(red) red[i] = R;
+        if(green) green[i] = G;
+        if(blue) blue[i] = B;
+
+        if(lms_used){
+            // sRGB --> XYZ
+            double X = 0.4124564*B + 0.3575761*G + 0.1804375*R;
+            double Y = 0.2126729*B + 0.7151522*G + 0.0721750*R;
+            double Z = 0.0193339*B + 0.1191920*G + 0.9503041*R;
+
+            // XYZ --> LMS
+            double s_cone = 0.38971*X + 0.68898*Y - 0.07868*Z;
+            double m_cone = -0.22981*X + 1.1834*Y + 0.04641*Z;
+            double l_cone = Z;
+
+            if(L) L[i] = l_cone;
+            if(M) M[i] = m_cone;
+            if(S) S[i] = s_cone;
+            if(rod) rod[i] = (s_cone + m_cone + l_cone)/3;
+        }
+    }
+}
+
+// The color transform is linear, so for a luminance input the same transform is applied once
+// to the channel gains and each channel used is the input multiplied by a scalar
+void Retina::convertLuminanceInput(const CImg<double> &input, long n_pixels){
+    double R = getInputGain(0), G = getInputGain(1), B = getInputGain(2);
+
+    // sRGB --> XYZ
+    double X = 0.4124564*B + 0.3575761*G + 0.1804375*R;
+    double Y = 0.2126729*B + 0.7151522*G + 0.0721750*R;
+    double Z = 0.0193339*B + 0.1191920*G + 0.9503041*R;
+
+    // XYZ --> LMS
+    double s_cone = 0.38971*X + 0.68898*Y - 0.07868*Z;
+    double m_cone = -0.22981*X + 1.1834*Y + 0.04641*Z;
+    double l_cone = Z;
+
+    const int channels[7] = {RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL, L_CONES_CHANNEL, M_CONES_CHANNEL, S_CONES_CHANNEL, RODS_CHANNEL};
+    const double gains[7] = {R, G, B, l_cone, m_cone, s_cone, (s_cone + m_cone + l_cone)/3};
+    const double *in = input.data();
+
+    for(int c=0;c<7;c++){
+        if(!channelUsed[channels[c]])
+            continue;
+
+        double gain = gains[c];
+        double *out = getChannelImage(channels[c])->data();
+        #pragma omp parallel for if(n_pixels >= 32768)
+        for(long i=0;i<n_pixels;i++)
+            out[i] = gain*in[i];
+    }
+}
+
 //------------------------------------------------------------------------------//
 
 void Retina::update(){
+    if(profiler && updateProfEntries.size() != modules.size())
+        createProfileEntries();
+
     for (size_t i=0;i<modules.size();i++){ // Update all modules, including Output and Input modules
         module* m = modules[i];
-        m->update();
+        if(!isReachable(i)) // Its output is not used
+            continue;
+
+        // Output of the interpolation interval which starts in this update (the module output
+        // does not change if the update is skipped)
+        bool interpolation = (i < lastUpdateSteps.size() && interpolatesOutput(i));
+        if(interpolation && isUpdateStep(i)){
+            CImg<double> *out = m->getOutput();
+            if(out != NULL)
+                previousOutputs[i] = *out;
+            lastUpdateSteps[i] = (long)stepCount;
+        }
+
+        if(i < skipUpdate.size() && skipUpdate[i]){ // Stateless module with unchanged input or held output
+            // The interpolated output read by other modules changes in every step
+            if(interpolation && !isUpdateStep(i))
+                m->newOutputVersion();
+            continue;
+        }
+
+        if(profiler){
+            double prof_start = profiler->now();
+            m->update();
+            // Estimation: the output image is read (state) and written
+            CImg<double> *out = m->getOutput();
+            profiler->record(updateProfEntries[i], prof_start, (out != NULL)? 2.0*out->size()*sizeof(double) : 0.0);
+        } else
+            m->update();
+
+        // Input modules set the version of their output when they get a new frame
+        if(i > 0)
+            m->newOutputVersion();
+    }
+    stepCount++;
+}
+
+void Retina::printSkippedUpdates(){
+    unsigned long total_steps = 0, total_skipped = 0;
+
+    for(size_t i=0;i<modules.size() && i<statelessSteps.size();i++){
+        if(statelessSteps[i] > 0){
+            cout << "Module " << modules[i]->getModuleID() << ": " << skippedUpdates[i] << " of " << statelessSteps[i] << " updates skipped (unchanged input)" << endl;
+            total_steps += statelessSteps[i];
+            total_skipped += skippedUpdates[i];
+        }
     }
+    if(total_steps > 0)
+        cout << "Skip rate of stateless modules: " << 100.0*total_skipped/total_steps << "%" << endl;
 }
 
 //------------------------------------------------------------------------------//
@@ -482,6 +990,10 @@ bool Retina::addModule(module *new_module, string new_mod_ID){
         correctly_added=true;
     }
     if(verbose && correctly_added) cout << "Module "<< new_module->getModuleID() << " added to the retina." << endl;
+    if(correctly_added){
+        connectionsCompiled = false;
+        moduleReachable.clear(); // Modules are simulated until the analysis is done again
+    }
     
     return(correctly_added);
 }
@@ -549,6 +1061,7 @@ bool Retina::connect(vector <string> from, const char *to,vector <int> operation
                 }
 
                 neuronto->addTypeSynapse(typeSyn);
+                connectionsCompiled = false;
                 if(verbose) cout << from.size() << " sources (..." << ((ff!=NULL)?ff:"") << ") have been conected to " << neuronto->getModuleID() << " module." << endl;
             }
         } // May have more modules (Output modules) with the same ID, so continue looping
@@ -557,6 +1070,141 @@ bool Retina::connect(vector <string> from, const char *to,vector <int> operation
 }
 
 
+//------------------------------------------------------------------------------//
+
+string Retina::sourceComputationID(const string &source_ID){
+    for(size_t m=0;m<modules.size();m++){
+        if(source_ID.compare(modules[m]->getModuleID())==0){
+            ModuleAlias *alias = dynamic_cast<ModuleAlias*>(modules[m]);
+            return((alias != NULL)? alias->getTarget()->getModuleID() : source_ID);
+        }
+    }
+    return source_ID; // Input channel
+}
+
+bool Retina::sameComputation(module *m1, module *m2){
+    if(m1->getSignature().compare(m2->getSignature()) != 0 || m1->getSizeID() != m2->getSizeID())
+        return false;
+
+    // Same sources (or aliases of them), operations and synapse type in every port
+    for(int o=0;o<m1->getSizeID();o++){
+        vector<string> from1 = m1->getID(o), from2 = m2->getID(o);
+        if(from1.size() != from2.size() || m1->getOperation(o) != m2->getOperation(o) || m1->getTypeSynapse(o) != m2->getTypeSynapse(o))
+            return false;
+        for(size_t k=0;k<from1.size();k++)
+            if(sourceComputationID(from1[k]).compare(sourceComputationID(from2[k])) != 0)
+                return false;
+    }
+    return true;
+}
+
+// Only the modules created by the retina script (with a signature) are merged: Input and Output
+// modules are never merged. Inputs are compared after resolving aliases, so merging modules can make
+// their destination modules identical, and the search is repeated until no module is merged
+int Retina::mergeDuplicateModules(){
+    int n_merged = 0;
+    bool merged = true;
+
+    while(merged){
+        merged = false;
+        for(size_t i=2;i<modules.size() && !merged;i++){
+            module *duplicate = modules[i];
+            if(duplicate->getSignature().empty())
+                continue;
+
+            for(size_t j=1;j<i && !merged;j++){
+                module *original = modules[j];
+                if(original->getSignature().empty() || !sameComputation(original, duplicate))
+                    continue;
+
+                if(verbose) cout << "Module " << duplicate->getModuleID() << " merged with module " << original->getModuleID() << " (same type, parameters and inputs)." << endl;
+
+                // The alias keeps the ID and position of the duplicate
+                ModuleAlias *alias = new ModuleAlias(original, sizeX, sizeY, step);
+                alias->setModuleID(duplicate->getModuleID());
+                alias->setDownsample(duplicate->getDownsample());
+                for(size_t k=1;k<modules.size();k++){
+                    ModuleAlias *other = dynamic_cast<ModuleAlias*>(modules[k]);
+                    if(other != NULL && other->getTarget() == duplicate)
+                        other->setTarget(original);
+                }
+                modules[i] = alias;
+                delete duplicate;
+
+                n_merged++;
+                merged = true;
+            }
+        }
+    }
+
+    if(n_merged > 0){
+        if(verbose) cout << "Duplicate modules merged (same type, parameters and inputs): " << n_merged << endl;
+        connectionsCompiled = false;
+    }
+    return n_merged;
+}
+
+//------------------------------------------------------------------------------//
+
+bool Retina::isReachable(size_t mod_ind){
+    return(mod_ind >= moduleReachable.size() || moduleReachable[mod_ind]);
+}
+
+int Retina::findUnreachableModules(const vector<bool> &observed){
+    const char *out_mod_id_start="Output";
+    vector<size_t> pending; // Reachable modules whose sources have not been visited
+    int n_unreachable = 0;
+
+    moduleReachable.assign(modules.size(), false);
+    for(size_t i=0;i<modules.size();i++){
+        string ID = modules[i]->getModuleID();
+        if(i == 0 || ID.compare(0,strlen(out_mod_id_start),out_mod_id_start) == 0 || (i < observed.size() && observed[i])){
+            moduleReachable[i] = true;
+            pending.push_back(i);
+        }
+    }
+
+    while(!pending.empty()){
+        module *neuron = modules[pending.back()];
+        vector<module*> sources;
+        pending.pop_back();
+
+        // The sources of a connection are the first modules with their IDs (as in compileConnections())
+        for(int o=0;o<neuron->getSizeID();o++){
+            vector<string> l = neuron->getID(o);
+            for(size_t k=0;k<l.size();k++){
+                for(size_t m=0;m<modules.size();m++){
+                    if(l[k].compare(modules[m]->getModuleID())==0){
+                        sources.push_back(modules[m]);
+                        break;
+                    }
+                }
+            }
+        }
+        ModuleAlias *alias = dynamic_cast<ModuleAlias*>(neuron);
+        if(alias != NULL)
+            sources.push_back(alias->getTarget());
+
+        for(size_t k=0;k<sources.size();k++){
+            for(size_t m=0;m<modules.size();m++){
+                if(modules[m] == sources[k] && !moduleReachable[m]){
+                    moduleReachable[m] = true;
+                    pending.push_back(m);
+                }
+            }
+        }
+    }
+
+    // Aliases of merged modules perform no computation, so they are not reported
+    for(size_t i=0;i<modules.size();i++){
+        if(!moduleReachable[i] && dynamic_cast<ModuleAlias*>(modules[i]) == NULL){
+            cout << "Warning: the output of module " << modules[i]->getModuleID() << " does not reach any Output module, multimeter or display, so it is not simulated." << endl;
+            n_unreachable++;
+        }
+    }
+    return n_unreachable;
+}
+
 //------------------------------------------------------------------------------//
 
 bool Retina::generateGrating(int type,double step,double lengthB,double length,double length2,int X,int Y,double freq,double T,double Lum,double Cont,double phi,double phi_t,double theta,double red, double green, double blue,double red_phi, double green_phi,double blue_phi){
@@ -6,6 +6,9 @@
  *
  * Description: the class Retina implements a vector of modules, manages their connections
  * and feed them with new input data every simulation step.
+ * In batch mode (script command BatchSize) several stimuli are simulated in one pass: all the
+ * images of the retina and its modules have one slice (depth) per stimulus. An input with a
+ * single slice is applied to all the stimuli of the batch.
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -24,15 +27,42 @@
 #include "impulse.h"
 #include "SpikingOutput.h"
 #include "SequenceOutput.h"
+#include "MonitorOutput.h"
+#include "Profiler.h"
 #include "StreamingInput.h"
+#include "ModuleAlias.h"
 
 using namespace cimg_library;
 using namespace std;
 
+// Retina input channels that can be used as the first source of a connection
+enum input_channel {NO_INPUT_CHANNEL=-1, L_CONES_CHANNEL, M_CONES_CHANNEL, S_CONES_CHANNEL, RODS_CHANNEL, RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL, ZEROS_CHANNEL, NUM_INPUT_CHANNELS};
+
+// Source of a connection resolved from its ID
+struct compiled_source {
+    module *source; // NULL if the source was not found
+    int index; // Position of the module which computes the output of the source (-1 if not found)
+    int downsample; // Downsampling factor of the grid of the source
+    int operation; // Operation with the accumulated input (0: add, 1: subtract, otherwise: divide)
+};
+
+// Input port of a module: its connection IDs are resolved once (see Retina::compileConnections())
+// instead of being searched every simulation step
+struct compiled_port {
+    int channel; // Input channel of the first source (NO_INPUT_CHANNEL if it is a module)
+    module *first; // First source module (NULL if it is an input channel or it was not found)
+    int firstIndex; // Position of the module which computes the output of the first source
+    int firstDownsample; // Downsampling factor of the grid of the first source (1 for input channels)
+    vector<compiled_source> others; // Sources accumulated to the first one
+    bool isCurrent; // Synapse type
+};
+
 class Retina{
 protected:
     // Image size
     int sizeX, sizeY;
+    // Number of stimuli simulated in one pass (depth of the images)
+    int batchSize;
     // simulation step time length and ppd
     double step;
     double pixelsPerDegree;
@@ -41,7 +71,7 @@ protected:
     CImg <double> *output;
     CImg <double> *accumulator;
     // retina input channels (for color conversion)
-    CImg<double> *RGBred, *RGBgreen, *RGBblue, *ch1, *ch2, *ch3, *rods, *X_mat, *Y_mat, *Z_mat;
+    CImg<double> *RGBred, *RGBgreen, *RGBblue, *ch1, *ch2, *ch3, *rods;
     // vector of retina modules
     vector <module*> modules;
     // Type of input
@@ -60,6 +90,68 @@ protected:
 
     // Display comments
     bool verbose;
+    // Fast math mode of the modules (see FastMath)
+    bool fastMath;
+
+    // Input ports of each module with their sources resolved and input channels used by them.
+    // Connections are compiled again when a module or a connection is added
+    vector< vector<compiled_port> > compiledPorts;
+    bool connectionsCompiled;
+    bool channelUsed[NUM_INPUT_CHANNELS];
+    void compileConnections();
+    CImg<double> *getChannelImage(int channel);
+
+    // The color conversion is skipped if the input frame has not changed since the last conversion
+    const CImg<double> *convertedInput;
+    unsigned long convertedInputVersion;
+    bool inputConverted;
+    unsigned long getInputVersion();
+    // Fused conversion of the input frame into the input channels used
+    void convertInputChannels(const CImg<double> &input);
+    void convertColorInput(const CImg<double> &input, long n_pixels, long plane);
+    void convertLuminanceInput(const CImg<double> &input, long n_pixels);
+    unsigned long channelsVersion; // Version of the input channel images (it changes in each conversion)
+
+    // Stateless modules (see module::isStateless()) are not fed nor updated in a step if the versions
+    // of their inputs have not changed since their last update
+    vector< vector<unsigned long> > lastInputVersions; // Versions of the module inputs in its last update
+    vector<bool> moduleFed; // The module has been fed at least once since connections were compiled
+    vector<bool> skipUpdate; // The update of the module is skipped in the current step
+    vector<unsigned long> statelessSteps, skippedUpdates; // Statistics of each module
+    void getInputVersions(size_t mod_ind, vector<unsigned long> &versions);
+
+    // Profiler of module calls (NULL if profiling is disabled) and its entry of each module
+    Profiler *profiler;
+    vector<int> feedProfEntries, updateProfEntries;
+    int inputProfEntry, colorProfEntry;
+    void createProfileEntries();
+
+    // Merging of duplicate modules: ID of the module which computes the output of a source
+    // (the target of an alias) and comparison of the signature and the inputs of two modules
+    string sourceComputationID(const string &source_ID);
+    bool sameComputation(module *m1, module *m2);
+
+    // Modules whose output reaches a sink (see findUnreachableModules()). The rest of modules are
+    // not allocated, fed nor updated. Empty if the analysis has not been done (all modules are simulated)
+    vector<bool> moduleReachable;
+    bool isReachable(size_t mod_ind);
+
+    // Multi-rate simulation: a module with an update period of N steps (see module::setUpdatePeriod())
+    // is only fed and updated every N steps, and its output is held in between. If the module
+    // interpolates its output, the modules connected to it read the linear interpolation between
+    // its previous output and the last one (computed once per step)
+    unsigned long stepCount; // Number of steps simulated since the retina was allocated
+    vector< CImg<double> > previousOutputs, interpolatedOutputs;
+    vector<long> lastUpdateSteps, interpolatedSteps;
+    bool isUpdateStep(size_t mod_ind);
+    bool interpolatesOutput(size_t mod_ind);
+    int computingModuleIndex(size_t mod_ind);
+    CImg<double> *getSourceOutput(module *source, int mod_ind);
+
+    // Modules can have a grid downsampled with respect to the input grid (see module::setDownsample()):
+    // the sources of a connection are resampled to the grid of the module fed
+    CImg<double> resampledSource;
+    const CImg<double> *resampleSource(const CImg<double> *image, int src_factor, int dst_factor);
 
 public:
     // Constructor, copy, destructor.
@@ -73,11 +165,23 @@ public:
     bool allocateValues();
     bool setSizeX(int x);
     bool setSizeY(int y);
+    bool setBatchSize(int b);
+    int getBatchSize();
+
+    // Resample an image of the grid downsampled by src_factor to the grid downsampled by dst_factor
+    // (width and height are the size of the input grid). Pixel j of a grid downsampled by f covers
+    // the input pixels j*f to j*f+f-1: each pixel of the reduced grid is the average of the source pixels
+    // whose center it contains, and the pixels of the enlarged grid are interpolated bilinearly
+    static void resampleImage(const CImg<double> &src, int src_factor, CImg<double> &dst, int dst_factor, int width, int height);
     bool set_step(double temporal_step);
     int getSizeX();
     int getSizeY();
     double getStep();
     bool setVerbosity(bool verbose_flag);
+    void setFastMath(bool fast_flag);
+    bool getFastMath();
+    void setProfiler(Profiler *prof);
+    Profiler *getProfiler();
     bool setSimCurrentTrial(double r);
     bool setSimTotalTrials(double r);
     bool setTotalSimTime(int t);
@@ -91,6 +195,8 @@ public:
     // New input and update of equations
     CImg<double> *feedInput(int step);
     void update();
+    // Print the number of updates of stateless modules skipped because their input did not change
+    void printSkippedUpdates();
 
     // New module
     bool addModule(module* m, string ID);
@@ -100,6 +206,14 @@ public:
     int getNumberModules();
     // Connect modules
     bool connect(vector <string> from, const char *to, vector <int> operations,const char *type_synapse);
+    // Replace the modules with the same signature and inputs as a previous module with aliases of it
+    // (repeated until no more modules can be merged). Returns the number of modules merged
+    int mergeDuplicateModules();
+    // Search backwards through the connections for the modules whose output reaches a sink: the Input,
+    // Output modules and the modules observed by the application (observed[i] for module i, such as
+    // displays and multimeters). A warning is shown for the rest of modules, which are not simulated.
+    // Returns the number of unreachable modules
+    int findUnreachableModules(const vector<bool> &observed);
 
     // Grating generator
     bool generateGrating(int type,double step,double lengthB,double length,double length2,int X,int Y,double freq,double T,double Lum,double Cont,double phi,double phi_t,double theta,double red, double green, double blue,double red_phi, double green_phi,double blue_phi);
@@ -114,6 +228,9 @@ public:
     // Impulse
     bool generateImpulse(double start, double stop, double amplitude, double offset, int X, int Y);
     CImg<double> *updateImpulse(double t);
+    // Gain of a color channel (0: red, 1: green, 2: blue) with respect to the input image
+    // (generators of achromatic stimuli produce a single luminance channel)
+    double getInputGain(int channel);
     // Use streaming video or sequence as retina input
     // A valid (non-dummy) Input module must be inserted in the retina to use these inputs
     // We need this method to distingish the other retina input types from the others implemented as modules
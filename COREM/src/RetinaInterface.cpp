@@ -2,10 +2,22 @@
 
 RetinaInterface::RetinaInterface(void):retina(1,1,1.0),displayMg(1,1),FileReaderObject(1,1,1.0){
     abortExecution = false;
+    profiler = NULL;
+    fastMathMode = -1;
+    skipUnreachable = true;
+    outputsResolved = false;
+    outputsRequested = false;
+    snapshotValid = false;
 }
 
 RetinaInterface::RetinaInterface(const RetinaInterface& copy){
     abortExecution = false;
+    profiler = NULL;
+    fastMathMode = copy.fastMathMode;
+    skipUnreachable = copy.skipUnreachable;
+    outputsResolved = false;
+    outputsRequested = false;
+    snapshotValid = false;
 
 }
 
@@ -22,6 +34,10 @@ void RetinaInterface::reset(int X, int Y, double tstep,int rep){
     FileReaderObject.reset(1,1,1.0);
     retina.reset(1,1,1.0);
     displayMg.reset();
+    outputSources.clear();
+    outputValues.clear();
+    outputsResolved = false;
+    snapshotValid = false;
 }
 
 //------------------------------------------------------------------------------//
@@ -38,6 +54,10 @@ int RetinaInterface::getTotalSimTime(){
     return totalSimTime;
 }
 
+int RetinaInterface::getSimTime(){
+    return SimTime;
+}
+
 //------------------------------------------------------------------------------//
 
 
@@ -52,11 +72,41 @@ void  RetinaInterface::setVerbosity(bool verbose_flag){
     retina.setVerbosity(verbose_flag);
 }
 
-bool RetinaInterface::allocateValues(const char *retinaPath, const char * outputFile,double outputfactor,double currentRep){
-    bool ret_correct;
+void RetinaInterface::setFastMath(bool fast_flag){
+    fastMathMode = fast_flag? 1 : 0;
+}
+
+void RetinaInterface::setSkipUnreachable(bool skip_flag){
+    skipUnreachable = skip_flag;
+}
 
+void RetinaInterface::setProfiler(Profiler *prof){
+    profiler = prof;
+    retina.setProfiler(prof);
+    if(profiler)
+        displayProfEntry = profiler->getEntry("DisplayManager", "display");
+}
+
+bool RetinaInterface::allocateValues(const char *retinaPath, const char * outputFile,double outputfactor,double currentRep){
     // Set input directory and parse the retina file
     FileReaderObject.setDir(retinaPath);
+    return(parseAndAllocate(currentRep));
+}
+
+bool RetinaInterface::loadScript(const string &script_text, double currentRep){
+    FileReaderObject.setScript(script_text);
+    return(parseAndAllocate(currentRep));
+}
+
+bool RetinaInterface::parseAndAllocate(double currentRep){
+    bool ret_correct;
+
+    // The trial is set before parsing the file since stochastic inputs draw their random numbers
+    // from the streams of the current trial. The default seed can be changed by the script (RandomSeed)
+    CounterRNG::setSeed(0);
+    CounterRNG::setTrial((uint64_t)currentRep);
+    retina.setSimCurrentTrial(currentRep);
+
     FileReaderObject.allocateValues();
     FileReaderObject.parseFile(retina,displayMg);
 
@@ -64,6 +114,10 @@ bool RetinaInterface::allocateValues(const char *retinaPath, const char * output
     // Set simulation time to 0
     SimTime = 0;
 
+    // The modules may have changed: the sources of the Output layers are searched again
+    outputsResolved = false;
+    snapshotValid = false;
+
     // Simulation parameters
     totalSimTime = retina.getTotalSimTime();
     totalNumberTrials = retina.getSimTotalTrials();
@@ -73,7 +127,17 @@ bool RetinaInterface::allocateValues(const char *retinaPath, const char * output
 
     if(FileReaderObject.getContReading()){
 
+        // Modules whose output is not used are not allocated nor simulated
+        if(skipUnreachable){
+            vector<bool> observed(retina.getNumberModules(), false);
+            for(int k=0;k<retina.getNumberModules();k++)
+                observed[k] = displayMg.isObserved(k, retina.getModule(k)->getModuleID());
+            retina.findUnreachableModules(observed);
+        }
+
         // Allocate retina object
+        if(fastMathMode >= 0)
+            retina.setFastMath(fastMathMode == 1);
         ret_correct = retina.allocateValues();
 
         // retina size and step
@@ -106,10 +170,23 @@ bool RetinaInterface::allocateValues(const char *retinaPath, const char * output
 void RetinaInterface::update(){
     CImg<double> *input;
     
+    if(profiler)
+        profiler->beginStep();
     input = retina.feedInput(SimTime);
     if(input!=NULL)
         retina.update(); // This call updates all the modules, so since input is a pointer the content may be modified
-    displayMg.updateDisplay(input, retina, SimTime, totalSimTime, CurrentTrial, totalNumberTrials);
+
+    // Snapshot of the Output layers read by getValue() (only if values have been requested)
+    snapshotValid = false;
+    if(outputsRequested)
+        snapshotOutputs();
+    if(profiler){
+        double prof_start = profiler->now();
+        displayMg.updateDisplay(input, retina, SimTime, totalSimTime, CurrentTrial, totalNumberTrials);
+        profiler->record(displayProfEntry, prof_start, 0.0);
+        profiler->endStep();
+    } else
+        displayMg.updateDisplay(input, retina, SimTime, totalSimTime, CurrentTrial, totalNumberTrials);
     SimTime+=step;
     if(input == NULL) // If this is the end of input, terminate simulation
         abortExecution=true;
@@ -118,50 +195,109 @@ void RetinaInterface::update(){
 //------------------------------------------------------------------------------//
 
 
-double RetinaInterface::getValue(double cell){
+// Search for the Output module, which is used to generate input current for NEST neurons,
+// and for the source module of each of its layers
+void RetinaInterface::resolveOutputSources(){
+    module *out_mod = NULL;
+
+    outputSources.clear();
 
-    int select_image = int(cell)/(sizeX*sizeY);
-    int pos_im = int(cell) - select_image*(sizeX*sizeY);
-    bool out_mod_found;
-    module *out_mod;
-    double neu_out_val;
-    
-    // Search for the Output module, which is used to generate input current for NEST neurons
-    // This operation should be fast as the (first) Output module is the position 1 of the array
     // We start search at position 1, since in the first position is the Input module
-    out_mod_found=false;
-    for(int module_ind=1; module_ind < retina.getNumberModules() && !out_mod_found; module_ind++){
-        out_mod = retina.getModule(module_ind);
-        if(out_mod->checkID("Output"))
-            out_mod_found=true; // Output module found: exit loop
+    for(int module_ind=1; module_ind < retina.getNumberModules() && out_mod == NULL; module_ind++){
+        if(retina.getModule(module_ind)->checkID("Output"))
+            out_mod = retina.getModule(module_ind); // Output module found: exit loop
     }
 
-    if(out_mod_found && out_mod->getSizeID() > select_image){
-        module *source_mod;
-        vector <string> layersID;
-        layersID = out_mod->getID(select_image);
-
-        const char * charIDO = layersID[0].c_str();
-        int neuron_to_display = 0;
-        // Search for source module of Output module
-        for(int k=0;k<retina.getNumberModules();k++){
-            source_mod = retina.getModule(k);
-            if(source_mod->checkID(charIDO)){
-                neuron_to_display = k;
-                break;
+    if(out_mod != NULL){
+        for(int layer=0;layer<out_mod->getSizeID();layer++){
+            vector <string> layersID = out_mod->getID(layer);
+            module *source_mod = retina.getModule(0); // Input module if the source is not found
+
+            for(int k=0;k<retina.getNumberModules();k++){
+                if(retina.getModule(k)->checkID(layersID[0].c_str())){
+                    source_mod = retina.getModule(k);
+                    break;
+                }
             }
+            outputSources.push_back(source_mod);
         }
-        source_mod = retina.getModule(neuron_to_display);
+    }
+    outputsResolved = true;
+}
 
-        int row = pos_im/sizeY;
-        int col = pos_im%sizeY;
-        neu_out_val = (*source_mod->getOutput())(col,row,0,0);
-    } else
+// Copy the Output layers into a flat array indexed by cell number: cell = layer*sizeX*sizeY + row*sizeY + col,
+// which is the memory layout of the layer images. Values of missing layers are -1
+void RetinaInterface::snapshotOutputs(){
+    size_t layer_size = (size_t)sizeX*sizeY;
+
+    if(!outputsResolved)
+        resolveOutputSources();
+
+    outputValues.resize(outputSources.size()*layer_size);
+    for(size_t layer=0;layer<outputSources.size();layer++){
+        double *values = outputValues.data() + layer*layer_size;
+        CImg<double> *layer_output = (outputSources[layer] != NULL)? outputSources[layer]->getOutput() : NULL;
+
+        if(layer_output != NULL && layer_output->size() >= layer_size)
+            memcpy(values, layer_output->data(), layer_size*sizeof(double));
+        else if(layer_output != NULL && outputSources[layer]->getDownsample() > 1){
+            // Downsampled layer: its values are interpolated in the input grid
+            Retina::resampleImage(*layer_output, outputSources[layer]->getDownsample(), upsampledLayer, 1, sizeY, sizeX);
+            memcpy(values, upsampledLayer.data(), layer_size*sizeof(double));
+        }
+        else
+            fill(values, values + layer_size, -1.0);
+    }
+    snapshotValid = true;
+}
+
+double RetinaInterface::getValue(double cell){
+    double neu_out_val;
+    long cell_ind = (long)cell;
+
+    if(!snapshotValid){
+        outputsRequested = true;
+        snapshotOutputs();
+    }
+
+    if(cell_ind >= 0 && (size_t)cell_ind < outputValues.size())
+        neu_out_val = outputValues[cell_ind];
+    else
         neu_out_val = -1;
 
     return(neu_out_val);
 }
 
+// Number of cells of the Output layers
+long RetinaInterface::getNumberOutputCells(){
+    if(!snapshotValid){
+        outputsRequested = true;
+        snapshotOutputs();
+    }
+    return((long)outputValues.size());
+}
+
+// Values of count consecutive cells starting at cell first (-1 for cells out of the Output layers).
+// Returns the number of cells inside the Output layers
+int RetinaInterface::getValues(long first, long count, double *out){
+    int num_valid = 0;
+
+    if(!snapshotValid){
+        outputsRequested = true;
+        snapshotOutputs();
+    }
+
+    for(long k=0;k<count;k++){
+        long cell_ind = first + k;
+        if(cell_ind >= 0 && (size_t)cell_ind < outputValues.size()){
+            out[k] = outputValues[cell_ind];
+            num_valid++;
+        } else
+            out[k] = -1;
+    }
+    return(num_valid);
+}
+
 //------------------------------------------------------------------------------//
 
 bool RetinaInterface::getAbortExecution(){
@@ -6,6 +6,9 @@
  *
  * Description: Interface with NEST. Functions update (integrate spatiotemporal equations)
  * and getValue (return membrane potential of neurons) allow communication with NEST.
+ * Once values are requested, the layers of the Output module are copied after each update
+ * into a flat array indexed by cell number, so that getValue and getValues (a block of
+ * consecutive cells) read them with direct indexing.
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -16,6 +19,8 @@
 
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <algorithm>
 
 #include "DisplayManager.h"
 #include "FileReader.h"
@@ -48,6 +53,28 @@ protected:
 
     bool abortExecution;
 
+    // Source modules of the Output layers and snapshot of their values after the last update
+    vector<module*> outputSources;
+    vector<double> outputValues;
+    CImg<double> upsampledLayer;
+    bool outputsResolved, outputsRequested, snapshotValid;
+    void resolveOutputSources();
+    void snapshotOutputs();
+
+    // Parse the retina script set in the file reader and allocate the retina
+    bool parseAndAllocate(double currentRep);
+
+    // Profiler of the simulation (NULL if profiling is disabled)
+    Profiler *profiler;
+    int displayProfEntry;
+
+    // Fast math mode forced by the application (-1 if the mode of the script is used)
+    int fastMathMode;
+
+    // The modules whose output does not reach an Output module, a multimeter or a display are
+    // not simulated (see Retina::findUnreachableModules())
+    bool skipUnreachable;
+
 public:
     // Constructor, copy, destructor.
     RetinaInterface(void);
@@ -56,15 +83,26 @@ public:
 
     double getTotalNumberTrials();
     int getTotalSimTime();
+    int getSimTime();
 
     void reset(int X, int Y, double tstep,int rep);
     bool allocateValues(const char * retinaPath, const char * outputFile, double outputfactor, double currentRep);
+    // Parse the text of a retina script instead of a file
+    bool loadScript(const string &script_text, double currentRep);
     void update();
     double getValue(double cell);
+    int getValues(long first, long count, double *out);
+    long getNumberOutputCells();
     bool getAbortExecution();
     Retina& getRetina();
     double getSimStep();
     void setVerbosity(bool verbose_flag);
+    void setProfiler(Profiler *prof);
+    // Enable or disable the fast math mode regardless of the retina script
+    void setFastMath(bool fast_flag);
+    // Enable or disable the skip of unreachable modules (enabled by default). It must be disabled if
+    // the application reads the output of modules which are not connected to an Output module
+    void setSkipUnreachable(bool skip_flag);
 
     // modification of generators (for optimization)
     void setWhiteNoise(double mean, double contrast1,double contrast2, double period, double switchT,string id,double start, double stop);
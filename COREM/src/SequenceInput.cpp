@@ -22,6 +22,7 @@ SequenceInput::SequenceInput(int x, int y, double temporal_step, string input_fi
     // Init. internal vars
     NextFrameTime = 0; // First frame must be received at time 0
     endOfInput = false;
+    frameWidth = frameHeight = frameChannels = 0;
 }
 
 // This method will probably not be used
@@ -32,9 +33,12 @@ SequenceInput::SequenceInput(const SequenceInput &copy):module(copy){
     InputFramePeriod = copy.InputFramePeriod;
     NextFrameTime = copy.NextFrameTime;
     CurrentInFrameInd = copy.CurrentInFrameInd;
-    inputFileList = copy.inputFileList;
-    inputMovie = copy.inputMovie;
+    inputFileLists = copy.inputFileLists;
+    inputMovies = copy.inputMovies;
     endOfInput = copy.endOfInput;
+    frameWidth = copy.frameWidth;
+    frameHeight = copy.frameHeight;
+    frameChannels = copy.frameChannels;
 
     outputImage=new CImg<double>(*copy.outputImage);
 }
@@ -48,28 +52,49 @@ SequenceInput::~SequenceInput(){
 //------------------------------------------------------------------------------//
 
 bool SequenceInput::openInput(){
+    bool ret_correct;
+    size_t path_start = 0, path_end;
+
+    // One input sequence for each stimulus of the batch
+    inputFileLists.clear();
+    inputMovies.clear();
+    ret_correct = true;
+    do{
+        path_end = InputFilePath.find('|', path_start);
+        string path = InputFilePath.substr(path_start, (path_end == string::npos)? string::npos : path_end - path_start);
+
+        inputFileLists.push_back(vector<string>());
+        inputMovies.push_back(CImg<double>());
+        ret_correct = ret_correct && openStimulus(path, inputFileLists.back(), inputMovies.back());
+        path_start = path_end + 1;
+    }while(ret_correct && path_end != string::npos);
+
+    return(ret_correct);
+}
+
+bool SequenceInput::openStimulus(const string &path, vector<string> &file_list, CImg<double> &movie){
     bool ret_correct;
     struct stat input_seq_path_stat;
 
     ret_correct = false; // default return value
 
     // Check if the specified input-sequence path is a directory or a movie file
-    if(stat(InputFilePath.c_str(), &input_seq_path_stat) == 0){
+    if(stat(path.c_str(), &input_seq_path_stat) == 0){
         if(verbose)
-            cout << "Opening image sequence: " << InputFilePath << "..." << endl;
+            cout << "Opening image sequence: " << path << "..." << endl;
         if(S_ISDIR(input_seq_path_stat.st_mode)){ // The user has specified a directory as input sequence: load all the directory files
             DIR *dp; // Pointer to the opened input-directiry stream 
-            dp = opendir(InputFilePath.c_str());
+            dp = opendir(path.c_str());
             if(dp != NULL){
                 dirent* de;
                 do{ // For each directory entry:
                     de = readdir(dp);
                     if(de != NULL){ // We got a valid entry
-                        string curr_input_file_path(InputFilePath + de->d_name); // Compose the entire current dir entry path
+                        string curr_input_file_path(path + de->d_name); // Compose the entire current dir entry path
                     
                         if(stat(curr_input_file_path.c_str(), &input_seq_path_stat) == 0){ // Try to get information about the de->d_name
                             if(!S_ISDIR(input_seq_path_stat.st_mode)){ // Subdirectories (including . and ..) are not included in the input file sequence
-                                inputFileList.push_back(curr_input_file_path);
+                                file_list.push_back(curr_input_file_path);
                                 ret_correct = true; // At least one image was found, proceed
                             }
                         }else{
@@ -80,19 +105,19 @@ bool SequenceInput::openInput(){
                 }while (de != NULL); // Continue while we get valid directory entries
                 closedir(dp);
                 if(ret_correct){
-                    sort(inputFileList.begin(), inputFileList.end()); // File will be load in alphabetical order
+                    sort(file_list.begin(), file_list.end()); // File will be load in alphabetical order
                     if(verbose)
-                        cout << inputFileList.size() << " files in directory" << endl;
+                        cout << file_list.size() << " files in directory" << endl;
                 }
             }else
-                cout << "Error reading retina script: Cannot open input sequence directory " << InputFilePath << endl;
+                cout << "Error reading retina script: Cannot open input sequence directory " << path << endl;
 
         } else { // The user has specified a file as input sequence: load the whole movie file
-            inputMovie.load_inr(InputFilePath.c_str()); // We assume that the specified file is a movie (sequence of images)
+            movie.load_inr(path.c_str()); // We assume that the specified file is a movie (sequence of images)
             ret_correct = true;
 
             if(verbose)
-                cout << inputMovie.depth() << " frames in movie file" << endl;
+                cout << movie.depth() << " frames in movie file" << endl;
         }
     } else
         perror("Error accessing the specified input sequence: ");
@@ -115,6 +140,10 @@ bool SequenceInput::allocateValues(){
     module::allocateValues(); // Call the allocateValues() method of the base class
     
     ret_correct = openInput(); // Load INR file or open directory
+    if(ret_correct && inputMovies.size() != 1 && (int)inputMovies.size() != batchSize){
+        cout << "Error reading retina script: the input has " << inputMovies.size() << " sequences but the batch size is " << batchSize << " (1 or " << batchSize << " sequences expected)" << endl;
+        ret_correct = false;
+    }
     if(ret_correct){
         if(SkipNInitFrames>0)
             cout << "Skipping " << SkipNInitFrames << " input frames" << endl;
@@ -122,7 +151,8 @@ bool SequenceInput::allocateValues(){
             skipFrame(); // Skip frame
             
         // Use the first frame to find out the new dimensions of retina image size
-        get_new_frame(); // Get first valid frame
+        frameWidth = frameHeight = frameChannels = 0;
+        ret_correct = get_new_frame(); // Get first valid frame
         sizeY=outputImage->width();
         sizeX=outputImage->height();
         NextFrameTime=InputFramePeriod; // Next frame must be read at this time
@@ -195,28 +225,56 @@ void SequenceInput::feedInput(double sim_time, const CImg<double> &new_input, bo
 
 //------------------------------------------------------------------------------//
 
-void SequenceInput::get_new_frame(){    
-    if(inputFileList.size() == 0){ // filename list is empty, so input was a movie file
-        if(CurrentInFrameInd < (unsigned long)inputMovie.depth()) // Some frames still availables to be read
-            *outputImage = inputMovie.get_slice(CurrentInFrameInd++);
-        else
-            if(!endOfInput && !RepeatLastFrame){
-                if(verbose)
-                    cout << "\rNo more input frames: terminating simulation" << endl;
-                endOfInput=true; // Indicate an end of input and simulation
+bool SequenceInput::get_new_frame(){
+    bool ret_correct = true;
+    size_t n_stimuli = inputMovies.size();
+    unsigned long n_frames = 0;
+
+    // Number of frames available in all the stimuli
+    for(size_t s=0;s<n_stimuli;s++){
+        unsigned long stim_frames = (inputFileLists[s].size() == 0)? (unsigned long)inputMovies[s].depth() : inputFileLists[s].size(); // filename list is empty if input was a movie file
+        if(s == 0 || stim_frames < n_frames)
+            n_frames = stim_frames;
+    }
+
+    if(CurrentInFrameInd < n_frames){ // Some frames still availables to be read
+        for(size_t s=0;s<n_stimuli;s++){
+            if(inputFileLists[s].size() == 0)
+                frame = inputMovies[s].get_slice(CurrentInFrameInd);
+            else
+                frame.load(inputFileLists[s].at(CurrentInFrameInd).c_str());
+
+            // The first frame determines the retina size
+            if(frameWidth == 0){
+                frameWidth = frame.width();
+                frameHeight = frame.height();
+                frameChannels = frame.spectrum();
+            }else if(frame.width() != frameWidth || frame.height() != frameHeight || frame.spectrum() != frameChannels){
+                cout << "Error: frame " << CurrentInFrameInd << " of input sequence " << s+1 << " has size " << frame.width() << "x" << frame.height() << "x" << frame.spectrum() << " but the retina input size is " << frameWidth << "x" << frameHeight << "x" << frameChannels << ": terminating simulation" << endl;
+                endOfInput = true;
+                ret_correct = false;
+                break;
             }
-    
-    } else { // Input was a directory
-        if(CurrentInFrameInd < inputFileList.size()) // Some files still availables to be read
-            outputImage->load(inputFileList.at(CurrentInFrameInd++).c_str());
-        else {
-            if(!endOfInput && !RepeatLastFrame){
-                if(verbose)
-                    cout << "\rNo more input images: terminating simulation" << endl;
-                endOfInput=true; // Indicate an end of input and simulation
+
+            if(n_stimuli == 1)
+                outputImage->swap(frame);
+            else{ // Each stimulus in one slice of the output
+                if(s == 0)
+                    outputImage->assign(frame.width(), frame.height(), n_stimuli, frame.spectrum());
+                outputImage->draw_image(0, 0, (int)s, 0, frame);
             }
         }
-    }
+        if(ret_correct){
+            CurrentInFrameInd++;
+            outputVersion++;
+        }
+    } else
+        if(!endOfInput && !RepeatLastFrame){
+            if(verbose)
+                cout << "\rNo more input frames: terminating simulation" << endl;
+            endOfInput=true; // Indicate an end of input and simulation
+        }
+    return(ret_correct);
 }
 
 void SequenceInput::update(){
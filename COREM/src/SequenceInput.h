@@ -6,6 +6,11 @@
  *
  * Description: Special retina module in charge of obtaining retina input images from a
  *              INR video file or a sequence of image files stored in a directory.
+ *              In batch mode (see Retina::setBatchSize()) the input path can contain several
+ *              paths separated by '|', one for each stimulus of the batch: the output image
+ *              has one slice per stimulus and the input ends with the shortest sequence. The
+ *              number of paths must be 1 (the same input for all the stimuli) or the batch size,
+ *              and all the frames must have the size of the first one (the retina size).
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -26,10 +31,12 @@ protected:
     // Internal variables
     CImg<double> *outputImage; // Buffer where Update() stores the received image for getOutput()
     double NextFrameTime; // Time at which the next frame must be received
-    string InputFilePath; // Path to the INR video file or to the directory contaning the image files 
+    string InputFilePath; // Path to the INR video file or to the directory contaning the image files ('|' separates the stimuli of a batch)
     unsigned long CurrentInFrameInd; // Number (index) of the input frame to load next
-    vector<string> inputFileList; // List of input-file names
-    CImg<double> inputMovie; // Volumetric image containing all the input frames
+    vector< vector<string> > inputFileLists; // List of input-file names of each stimulus
+    vector< CImg<double> > inputMovies; // Volumetric image containing all the input frames of each stimulus
+    CImg<double> frame; // Frame of one stimulus
+    int frameWidth, frameHeight, frameChannels; // Size of the first frame (0 until it is loaded)
     bool endOfInput; // Indicates that the end if input file (or directory) has been reached. Next module output should be NULL
     
     // SequenceInput operation parameters
@@ -45,6 +52,7 @@ public:
 
     // This method opens the specified input (file or directory). If it is a file, it loads the file into memory
     bool openInput();
+    bool openStimulus(const string &path, vector<string> &file_list, CImg<double> &movie);
 
     // This method closes the input
     void closeInput();
@@ -63,8 +71,9 @@ public:
     // Only used to update the object simulation time
     virtual void feedInput(double sim_time, const CImg<double> &new_input, bool isCurrent, int port);
     
-    // Wait until a new frame is available and update output image buffer
-    void get_new_frame();
+    // Wait until a new frame is available and update output image buffer. It returns false if
+    // the frame does not have the size of the first one (and the input is terminated)
+    bool get_new_frame();
     
     // update output image according to current sim. time, waiting for a new frame if needed
     virtual void update();
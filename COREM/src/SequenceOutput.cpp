@@ -49,7 +49,7 @@ SequenceOutput::SequenceOutput(const SequenceOutput &copy):module(copy){
     
     out_seq_file_handle.open(out_seq_filename, ios::out | ios::binary);
     if(out_seq_file_handle.is_open())
-        out_seq_file_handle.seekp(INR_HEADER_LEN+sizeX*sizeY*sizeof(double)*num_written_frames, ios::beg); // move file pointer to the end of written data
+        out_seq_file_handle.seekp(INR_HEADER_LEN+sizeX*sizeY*batchSize*sizeof(double)*num_written_frames, ios::beg); // move file pointer to the end of written data
 
     inputImage=new CImg<double>(*copy.inputImage);
 }
@@ -69,7 +69,7 @@ bool SequenceOutput::allocateValues(){
     module::allocateValues(); // Use the allocateValues() method of the base class
     
     // Resize initial value
-    inputImage->assign(sizeY, sizeX, 1, 1, 0);
+    inputImage->assign(sizeY, sizeX, batchSize, 1, 0);
     return(true);
 }
 
@@ -202,7 +202,7 @@ bool SequenceOutput::WriteINRFrame() {
     
     input_image_data = inputImage->data(); // Pointer to the first pixel value
     if(input_image_data != NULL){ // If the image is not empty
-        out_seq_file_handle.write((char *)input_image_data, sizeX*sizeY*sizeof(double)); // Write last part of the header (which is fixed)
+        out_seq_file_handle.write((char *)input_image_data, sizeX*sizeY*batchSize*sizeof(double)); // Write last part of the header (which is fixed)
         ret_correct=out_seq_file_handle.good();
     } else
         ret_correct=true;
@@ -239,7 +239,7 @@ bool SequenceOutput::CloseINRFile() {
     char inr_header[INR_HEADER_LEN];
     int n_printed_chars;
          
-    snprintf(inr_header, INR_HEADER_LEN, INR_HEADER_START, sizeY, sizeX, num_written_frames, Voxel_X_size, Voxel_Y_size, sizeof(double)*8, getEndianness()); // popullate header buffer
+    snprintf(inr_header, INR_HEADER_LEN, INR_HEADER_START, sizeY, sizeX*batchSize, num_written_frames, Voxel_X_size, Voxel_Y_size, sizeof(double)*8, getEndianness()); // popullate header buffer
     n_printed_chars = strlen(inr_header); // snprintf must always write a \0 char, so we can use strlen safely
     memset(inr_header+n_printed_chars, ' ', INR_HEADER_LEN-n_printed_chars); // Pad the remaining header buffer with spaces to fill the space which is not used
     memcpy(inr_header+INR_HEADER_LEN-(sizeof(INR_HEADER_END)-1), INR_HEADER_END, sizeof(INR_HEADER_END)-1); // Write the last part of the header
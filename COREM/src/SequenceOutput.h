@@ -6,6 +6,8 @@
  *
  * Description: Special retina module in charge of saving the retina output in a file as a image sequence.
  * In particular it can create an INR video file containing one image per simulation time step.
+ * In batch mode (see Retina::setBatchSize()) the images of the stimuli of the batch are stacked
+ * vertically in each frame: the image of stimulus b starts at row b*sizeX.
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
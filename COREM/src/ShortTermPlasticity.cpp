@@ -17,34 +17,37 @@ ShortTermPlasticity::ShortTermPlasticity(int x,int y,double temporal_step,double
         threshold = 0.0;
     }
     
-    inputImage = new CImg<double>*[7];
-    for (int i=0;i<7;i++)
-        inputImage[i]=new CImg<double>(sizeY,sizeX,1,1,0.0);
+    decay = exp(-step/tau);
+
+    inputImage=new CImg<double> (sizeY,sizeX,1,1,0.0);
+    km=new CImg<double> (sizeY,sizeX,1,1,0.0);
+    P=new CImg<double> (sizeY,sizeX,1,1,0.0);
     outputImage=new CImg<double> (sizeY,sizeX,1,1,0.0);
 }
 
 ShortTermPlasticity::ShortTermPlasticity(const ShortTermPlasticity& copy):module(copy){
     slope=copy.slope;
     offset=copy.offset;
-    exponent=exponent;
+    exponent=copy.exponent;
 
     kf=copy.kf;
     kd=copy.kd;
     tau=copy.tau;
+    decay=copy.decay;
 
     isThreshold=copy.isThreshold;
     threshold=copy.threshold;
     
-    inputImage = new CImg<double>*[7];
-    for (int i=0;i<7;i++)
-        inputImage[i]=new CImg<double>(*(copy.inputImage[i]));
+    inputImage=new CImg<double>(*(copy.inputImage));
+    km=new CImg<double>(*(copy.km));
+    P=new CImg<double>(*(copy.P));
     outputImage=new CImg<double> (*(copy.outputImage));
 }
 
 ShortTermPlasticity::~ShortTermPlasticity(){
-    for (int i=0;i<7;i++)
-        delete inputImage[i];
-    delete[] inputImage;
+    delete inputImage;
+    delete km;
+    delete P;
     delete outputImage;
 }
 
@@ -94,76 +97,86 @@ bool ShortTermPlasticity::setTau(double p3){
 
 bool ShortTermPlasticity::allocateValues(){
     // Resize buffer images to current retina size
-    for (int i=0;i<7;i++)
-        inputImage[i]->assign(sizeY, sizeX, 1, 1, 0.1);
-    outputImage->assign(sizeY, sizeX, 1, 1, 0.1);
-    
+    inputImage->assign(sizeY, sizeX, batchSize, 1, 0.1);
+    km->assign(sizeY, sizeX, batchSize, 1, 0.1);
+    P->assign(sizeY, sizeX, batchSize, 1, 0.1);
+    outputImage->assign(sizeY, sizeX, batchSize, 1, 0.1);
+
     // exp(-step/tau)
-    inputImage[5]->fill(-step/tau);
-    inputImage[5]->exp();
+    decay = exp(-step/tau);
 
     return(true);
 }
 
 void ShortTermPlasticity::feedInput(double sim_time, const CImg<double>& new_input, bool isCurrent, int port){
     // copy input image
-    *inputImage[0] = new_input;
+    *inputImage = new_input;
+}
+
+// Same results as CImg::pow() (which special-cases these exponents)
+inline double ShortTermPlasticity::applyExponent(double value) const{
+    if(exponent==1.0)
+        return value;
+    else if(exponent==2.0)
+        return value*value;
+    else if(exponent==0.5)
+        return sqrt(value);
+    else if(exponent==0.0)
+        return 1.0;
+    else if(exponent==3.0)
+        return value*value*value;
+    else if(exponent==4.0)
+        return value*value*value*value;
+    else if(exponent==-0.5)
+        return 1/sqrt(value);
+    else if(exponent==-1.0)
+        return 1.0/value;
+    else if(exponent==-2.0)
+        return 1.0/(value*value);
+    else if(exponent==-3.0)
+        return 1.0/(value*value*value);
+    else if(exponent==-4.0)
+        return 1.0/(value*value*value*value);
+    return pow(value,exponent);
 }
 
 void ShortTermPlasticity::update(){
     // kmInf = (kd/(abs(input)))
     // km(t+1) = kmInf + [km(t) - kmInf]*exp(-step/tau)
     // P = P + kf*(km*abs(input) - P)
-
-    // ImagePointer[0] -> input image
-    // ImagePointer[1] -> abs(input image)
-    // ImagePointer[2] -> P
-    // ImagePointer[3] -> km(t)
-    // ImagePointer[4] -> kmInf
-    // ImagePointer[5] -> exp(-step/tau)
-    // ImagePointer[6] -> km(t-1)
-
-    // km(t-1)
-    (*(inputImage[6]))=(*(inputImage[3]));
-    (*(inputImage[3])).fill(0.0);
-
-    // abs(input)
-    *inputImage[1] = *inputImage[0];
-    (inputImage[1])->abs();
-    (*inputImage[1])+= DBL_EPSILON_STP;
-
-    // kmInf
-    (inputImage[4])->fill(kd);
-    (inputImage[4])->div((*(inputImage[1])));
-
-    // update of km(t)
-    (*inputImage[3]) += (*inputImage[4]);
-    (*inputImage[3]) -= (*(inputImage[4])).mul(*(inputImage[5]));
-    (*inputImage[3]) += (*(inputImage[6])).mul(*(inputImage[5]));
-
-    // km(t)*abs(input)
-    (*inputImage[1]) = *inputImage[0];
-    (inputImage[1])->abs();
-    (inputImage[1])->mul(*inputImage[3]);
-
-    // update of P
-    (*inputImage[2])+= kf*(*inputImage[1] - *inputImage[2]);
-
-    // Threshold
-    if(isThreshold){
-        cimg_forXY((*inputImage[0]),x,y) {
-            if((*inputImage[0])(x,y,0,0) < threshold)
-                (*inputImage[0])(x,y,0,0) = threshold;
-        }
+    // output = (slope*max(input,threshold) + offset + P)^exponent
+
+    // The equations are computed in a single pass over the pixels. The approximation of the
+    // exponent is chosen before the loop
+    const double *in = inputImage->data();
+    double *km_ptr = km->data();
+    double *P_ptr = P->data();
+    double *out = outputImage->data();
+    const double min_value = isThreshold? threshold : -numeric_limits<double>::infinity();
+    const long n_pixels = (long)inputImage->size();
+    const bool fastExponent = fastMath && !FastMath::isExactExponent(exponent);
+    const FastMath::Power fastPower(exponent);
+
+    #pragma omp parallel for simd if(n_pixels >= 16384)
+    for(long i=0;i<n_pixels;i++){
+        double value = in[i];
+        double abs_value = fabs(value);
+
+        // update of km(t)
+        double kmInf = kd/(abs_value + DBL_EPSILON_STP);
+        double km_value = (kmInf - kmInf*decay) + km_ptr[i]*decay;
+        km_ptr[i] = km_value;
+
+        // update of P
+        double P_value = P_ptr[i];
+        P_value += kf*(abs_value*km_value - P_value);
+        P_ptr[i] = P_value;
+
+        // threshold, slope, constant offset and exponent
+        value = (value < min_value)? min_value : value;
+        value = value*slope + offset + P_value;
+        out[i] = fastExponent? fastPower(value) : applyExponent(value);
     }
-
-    // slope, constant offset and exponent
-    (*inputImage[0])*=slope;
-    (*inputImage[0])+=offset;
-    (*inputImage[0])+=(*inputImage[2]);
-    inputImage[0]->pow(exponent);
-
-    *outputImage = *inputImage[0];
 }
 
 //------------------------------------------------------------------------------//
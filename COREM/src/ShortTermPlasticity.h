@@ -14,8 +14,10 @@
 
 #include <iostream>
 #include <vector>
+#include <limits>
 
 #include "module.h"
+#include "FastMath.h"
 
 #define DBL_EPSILON_STP 1.0e-2
 
@@ -29,11 +31,18 @@ protected:
     bool isThreshold;
     // STP parameters
     double kf,kd,tau;
+    // exp(-step/tau)
+    double decay;
 
-    // Buffers
-    CImg<double> **inputImage;
+    // Buffers: input, state of the STP term (km and P) and output
+    CImg<double> *inputImage;
+    CImg<double> *km;
+    CImg<double> *P;
     CImg<double> *outputImage;
 
+    // exponent of the nonlinearity (exact computation)
+    double applyExponent(double value) const;
+
 public:
     // Constructor, copy, destructor.
     ShortTermPlasticity(int x=1,int y=1,double temporal_step=1.0,double Am=1.0,double Vm=0.0,double Em=1.0, double th = 0.0, bool isTh=false);
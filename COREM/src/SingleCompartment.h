@@ -19,6 +19,7 @@
 
 #include "module.h"
 #include "constants.h"
+#include "FastMath.h"
 
 using namespace cimg_library;
 using namespace std;
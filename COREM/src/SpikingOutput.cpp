@@ -6,7 +6,6 @@
 #include <iterator>
 #include <string>
 
-#include <random> // To generate neuron noise
 #include <ctime> // To log the current time in output spike file
 #include <limits>
 #include <iomanip> // for std::setprecision 
@@ -39,13 +38,7 @@ SpikingOutput::SpikingOutput(int x, int y, double temporal_step, string output_f
     
     First_spk_delay=1.0; // Neurons start firing after the complete first spiking period
     
-    normal_distribution<double>::param_type init_norm_dist_params(Min_period/1000.0, Min_period_std_dev/1000.0); // Random numbers from a Gaussian distribution of mean=Min_period/1000.0 and sigma=Min_period_std_dev/1000.0 seconds
-    norm_dist.param(init_norm_dist_params); // Set params of normal distribution
-    
-    uniform_real_distribution<double>::param_type init_unif_dist_params(0.0, 1.0); // Random numbers distributed uniformly between 0 and 1 (not included)
-    unif_dist.param(init_unif_dist_params); // Set params of uniform distribution
-
-    // Gamma params set in allocateValues()
+    // Random streams are seeded in allocateValues()
 
     // Input buffer
     inputImage=new CImg<double> (sizeY, sizeX, 1, 1, 0);
@@ -66,9 +59,7 @@ SpikingOutput::SpikingOutput(const SpikingOutput &copy):module(copy){
     out_spk_filename = copy.out_spk_filename;
     Random_init = copy.Random_init;
     First_spk_delay = copy.First_spk_delay;
-    norm_dist = copy.norm_dist;
-    unif_dist = copy.unif_dist;
-    gam_dist = copy.gam_dist;
+    neu_rand_streams = copy.neu_rand_streams;
 
     inputImage=new CImg<double>(*copy.inputImage);
     next_spk_time=new CImg<double>(*copy.next_spk_time);
@@ -91,12 +82,14 @@ SpikingOutput::~SpikingOutput(){
 
 void SpikingOutput::randomize_state(){
     CImg<double>::iterator next_spk_time_it = next_spk_time->begin();
+    vector<RandomStream>::iterator rand_stream_it = neu_rand_streams.begin();
 
     while(next_spk_time_it < next_spk_time->end()){ // For every spiking output
         // To randomize the state of each output, we set the last next_spk_time
         // to the next firing reduced to a random percentage defined by Random_init.
-        *next_spk_time_it = (1.0 - Random_init*unif_dist(rand_gen)) * *next_spk_time_it; // random number in the interval [0,1) seconds from unif. dist. multiplied by previous initial firing period
+        *next_spk_time_it = (1.0 - Random_init*rand_stream_it->uniform()) * *next_spk_time_it; // random number in the interval [0,1) seconds from unif. dist. multiplied by previous initial firing period
         next_spk_time_it++;
+        rand_stream_it++;
     }
 }
 
@@ -105,6 +98,7 @@ void SpikingOutput::randomize_state(){
 void SpikingOutput::initialize_state(){
     CImg<double>::iterator next_spk_time_it = next_spk_time->begin();
     CImg<double>::iterator curr_ref_period_it = curr_ref_period->begin();
+    vector<RandomStream>::iterator rand_stream_it = neu_rand_streams.begin();
 
     while(next_spk_time_it < next_spk_time->end()){ // For every spiking output
         double first_firing_period;
@@ -113,7 +107,7 @@ void SpikingOutput::initialize_state(){
         
         // Determine firing period in the "unwarped" time slot
         if(isfinite(Spike_dist_shape)) // Select stochastic or deterministic spike times
-            first_firing_period = gam_dist(rand_gen);
+            first_firing_period = rand_firing_period(*rand_stream_it);
         else // Spike_dist_shape is infinite (not specified), so we do not use stochasticity
             first_firing_period = 1; // 1Hz is the firing freq. in a "unwarped" time slot
 
@@ -123,10 +117,11 @@ void SpikingOutput::initialize_state(){
         if(Min_period_std_dev == 0.0) // If fixed refractory period:
             *curr_ref_period_it = Min_period/1000.0;
         else
-            *curr_ref_period_it = norm_dist(rand_gen);
+            *curr_ref_period_it = rand_ref_period(*rand_stream_it);
             
         next_spk_time_it++;
         curr_ref_period_it++;
+        rand_stream_it++;
     }
 }
 
@@ -135,18 +130,17 @@ void SpikingOutput::initialize_state(){
 bool SpikingOutput::allocateValues(){
     module::allocateValues(); // Use the allocateValues() method of the base class
 
-    // Set parameters of distributions for random number generation
-    normal_distribution<double>::param_type init_norm_dist_params(Min_period/1000.0, Min_period_std_dev/1000.0); // (mean=Min_period/1000.0, sigma=Min_period_std_dev/1000.0 seconds)
-    norm_dist.param(init_norm_dist_params); // Set initial params of normal distribution
-
-    gamma_distribution<double>::param_type init_gam_dist_params(Spike_dist_shape, 1.0/Spike_dist_shape); // Parameters of gamma distribution for spike: gam_k (alpha), gam_theta (beta)
-    gam_dist.param(init_gam_dist_params); // Set params of uniform distribution
+    // Seed one random stream per neuron: the stream key depends on the global seed, the trial and the module ID
+    uint64_t rand_key = CounterRNG::streamKey("SpikingOutput/" + getModuleID());
+    neu_rand_streams.resize((size_t)sizeX*sizeY*batchSize);
+    for(size_t n=0;n<neu_rand_streams.size();n++)
+        neu_rand_streams[n].seed(rand_key, n);
 
     // Resize initial image buffers
-    inputImage->assign(sizeY, sizeX, 1, 1, 0.0);
-    next_spk_time->assign(sizeY, sizeX, 1, 1, First_spk_delay);
-    last_spk_time->assign(sizeY, sizeX, 1, 1, -numeric_limits<double>::infinity());
-    curr_ref_period->assign(sizeY, sizeX, 1, 1, Min_period/1000.0);
+    inputImage->assign(sizeY, sizeX, batchSize, 1, 0.0);
+    next_spk_time->assign(sizeY, sizeX, batchSize, 1, First_spk_delay);
+    last_spk_time->assign(sizeY, sizeX, batchSize, 1, -numeric_limits<double>::infinity());
+    curr_ref_period->assign(sizeY, sizeX, batchSize, 1, Min_period/1000.0);
 
     initialize_state(); // Set ref. period and unwarped first spike time
 
@@ -375,9 +369,17 @@ double SpikingOutput::apply_ref_period(double new_spk_time, double last_spk_time
     return(ref_spk_time);
 }
 
-void SpikingOutput::renew_ref_period_val(CImg<double>::iterator curr_ref_period_it){
+double SpikingOutput::rand_ref_period(RandomStream &rand_stream){
+    return(rand_stream.normal(Min_period/1000.0, Min_period_std_dev/1000.0)); // (mean=Min_period/1000.0, sigma=Min_period_std_dev/1000.0 seconds)
+}
+
+double SpikingOutput::rand_firing_period(RandomStream &rand_stream){
+    return(rand_stream.gamma(Spike_dist_shape, 1.0/Spike_dist_shape)); // gam_k (alpha), gam_theta (beta): mean period is 1
+}
+
+void SpikingOutput::renew_ref_period_val(CImg<double>::iterator curr_ref_period_it, RandomStream &rand_stream){
     if(Min_period_std_dev > 0.0) // Add Gaussian white noise to the ref. period: Stochastic Min_period limit chosen
-        *curr_ref_period_it = norm_dist(rand_gen); // We only renew the refractory period time after the neuron fires. Since only one realization of the period is considered the distribution std. dev. does not need to be adjusted, as it is in DOI:10.1523/JNEUROSCI.3305-05.2005
+        *curr_ref_period_it = rand_ref_period(rand_stream); // We only renew the refractory period time after the neuron fires. Since only one realization of the period is considered the distribution std. dev. does not need to be adjusted, as it is in DOI:10.1523/JNEUROSCI.3305-05.2005
     // Else: no noise in freq limit.: fixed limit already set
 }
 
@@ -386,7 +388,7 @@ void SpikingOutput::renew_ref_period_val(CImg<double>::iterator curr_ref_period_
 // told_next_spk specifies the real time of spike (warped)
 // So, the length of a warped simulation time slot is step and
 // the length of a unwarped simulation time slot is step*mean_firing_rate, this is step/inp_pix_per
-vector<spike_t> SpikingOutput::stochastic_spike_generation(unsigned long out_neu_idx, double input_val, CImg<double>::iterator next_spk_time_it, CImg<double>::iterator last_spk_time_it, CImg<double>::iterator curr_ref_period_it){
+vector<spike_t> SpikingOutput::stochastic_spike_generation(unsigned long out_neu_idx, double input_val, CImg<double>::iterator next_spk_time_it, CImg<double>::iterator last_spk_time_it, CImg<double>::iterator curr_ref_period_it, RandomStream &rand_stream){
     vector<spike_t> slot_spks; // Temporal vector of output spikes for current sim. time slot
     // Intermediate variables used to calculate next spike time
     double inp_pix_per;
@@ -417,11 +419,11 @@ vector<spike_t> SpikingOutput::stochastic_spike_generation(unsigned long out_neu
 
             slot_spks.push_back(new_spk); // Insert spike in list
             *last_spk_time_it = new_spk.time; // Update last spike time
-            renew_ref_period_val(curr_ref_period_it);
+            renew_ref_period_val(curr_ref_period_it, rand_stream);
             
             // Determine firing period in the "unwarped" time slot
             if(isfinite(Spike_dist_shape)) // Select stochastic or deterministic spike times
-                firing_period = gam_dist(rand_gen);
+                firing_period = rand_firing_period(rand_stream);
             else // Spike_dist_shape is infinite (not specified), so we do not use stochasticity
                 firing_period = 1; // 1Hz is the firing freq. in a "unwarped" time slot
         
@@ -453,33 +455,30 @@ bool spk_time_comp(spike_t spk1, spike_t spk2){
     }
 
 void SpikingOutput::update(){
-    unsigned long out_neu_idx; // Index to the current neuron (or image pixel)
-    CImg<double>::iterator inp_img_it = inputImage->begin();
-    CImg<double>::iterator next_spk_time_it = next_spk_time->begin();
-    CImg<double>::iterator last_spk_time_it = last_spk_time->begin();
-    CImg<double>::iterator curr_ref_period_it = curr_ref_period->begin();
     vector<spike_t> slot_spks; // Temporal vector of output spikes for current sim. time slot
+    unsigned long num_neurons = 0UL; // Number of neurons (image pixels) selected by user
 
-    out_neu_idx=0UL;
-    inp_img_it+=First_inp_ind; // start from the pixl selected by user
-    next_spk_time_it+=First_inp_ind;
-    last_spk_time_it+=First_inp_ind;
-    curr_ref_period_it+=First_inp_ind;
-    // For each image input pixel:
-    while(inp_img_it<inputImage->end() && out_neu_idx<Total_inputs){ // we use inp_img_it.end() as upper bound for all iterators
-        vector<spike_t> neu_spks;
-        double input_val=*inp_img_it;
-        
-        neu_spks = stochastic_spike_generation(out_neu_idx, input_val, next_spk_time_it, last_spk_time_it, curr_ref_period_it);
-        
-        slot_spks.insert(slot_spks.end(), neu_spks.begin(), neu_spks.end()); // Append spikes of current neuron
-        
-        // Switch to the next neuron (pixel)
-        inp_img_it+=Inp_ind_inc;
-        next_spk_time_it+=Inp_ind_inc;
-        last_spk_time_it+=Inp_ind_inc;
-        curr_ref_period_it+=Inp_ind_inc;
-        out_neu_idx++;
+    if(First_inp_ind < inputImage->size())
+        num_neurons = min((unsigned long)((inputImage->size() - First_inp_ind - 1)/Inp_ind_inc + 1), Total_inputs);
+
+    // Neurons are independent (each one has its own random stream), so they are updated in parallel.
+    // The spikes of each thread are then merged and sorted, so the result does not depend on the number of threads
+    #pragma omp parallel if(num_neurons >= 256)
+    {
+        vector<spike_t> thread_spks;
+
+        #pragma omp for schedule(static) nowait
+        for(long out_neu_idx=0;out_neu_idx<(long)num_neurons;out_neu_idx++){
+            size_t pix_ind = First_inp_ind + out_neu_idx*Inp_ind_inc; // start from the pixl selected by user
+            vector<spike_t> neu_spks;
+
+            neu_spks = stochastic_spike_generation(out_neu_idx, (*inputImage)[pix_ind], next_spk_time->begin()+pix_ind, last_spk_time->begin()+pix_ind, curr_ref_period->begin()+pix_ind, neu_rand_streams[pix_ind]);
+
+            thread_spks.insert(thread_spks.end(), neu_spks.begin(), neu_spks.end()); // Append spikes of current neuron
+        }
+
+        #pragma omp critical
+        slot_spks.insert(slot_spks.end(), thread_spks.begin(), thread_spks.end());
     }
 
     //cout << "["<< simTime << ", " << simTime+step << "] ";
@@ -492,6 +491,7 @@ void SpikingOutput::update(){
     // output spike list
     std::sort(slot_spks.begin(), slot_spks.end(), spk_time_comp);
     out_spks.insert(out_spks.end(), slot_spks.begin(), slot_spks.end());
+    last_slot_spks.swap(slot_spks);
 }
 
 //------------------------------------------------------------------------------//
@@ -10,6 +10,8 @@
  * This module supports deterministics or stochastic spikes times.
  * A piecewise-stationary gamma process is implemented to generate stochastic spikes times.
  * Therefore, the generated inter-spike intervals (ISI) are drawn from the gamma distribution.
+ * In batch mode (see Retina::setBatchSize()) the input pixels of stimulus b follow those of
+ * stimulus b-1, so pixel p of stimulus b is the input index b*sizeX*sizeY + p.
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -20,8 +22,8 @@
 
 #include <vector>
 #include <string>
-#include <random>
 #include "module.h"
+#include "CounterRNG.h"
 
 using namespace cimg_library;
 using namespace std;
@@ -44,12 +46,13 @@ protected:
     // Current refractory period for each output neuron (in seconds). It is used only to check the refractory period
     CImg<double> *curr_ref_period; // This time value is change if Min_period_std_dev is not 0 
 
-    default_random_engine rand_gen; // For generating random numbers: neuron output random noise, random states and refractory period
-    normal_distribution<double> norm_dist; // For introducing noise in neuron random max. firing rate
-    gamma_distribution<double> gam_dist; // For generating random spike times
-    uniform_real_distribution<double> unif_dist; // For generating neuron random init states
+    // One random stream per output neuron (substream of the module stream indexed by pixel offset) for
+    // generating neuron output random noise, random states and refractory period. Since the random numbers of
+    // a neuron do not depend on the other neurons, they can be updated in parallel with reproducible results
+    vector<RandomStream> neu_rand_streams;
 
     vector<spike_t> out_spks; // Vector of retina output spikes
+    vector<spike_t> last_slot_spks; // Spikes generated in the last update (sim. slot), sorted by time
 
     string out_spk_filename; // filename (including path) to the spike output file to create
     
@@ -111,8 +114,12 @@ public:
     // Apply refractory period effect to a new spike time
     double apply_ref_period(double new_spk_time, double last_spk_time, double cur_min_period);
 
+    // Random refractory period (normal distribution) and unwarped firing period (gamma distribution) of a neuron
+    double rand_ref_period(RandomStream &rand_stream);
+    double rand_firing_period(RandomStream &rand_stream);
+
     // Renew the value of the refractory periodof a neuron
-    void renew_ref_period_val(CImg<double>::iterator curr_ref_period_it);
+    void renew_ref_period_val(CImg<double>::iterator curr_ref_period_it, RandomStream &rand_stream);
 
     // This method basically gerates spike times during current simulation time slot for one neuron.
     // For this, this method calculates the firing period (ISI) corresponding to the current input and
@@ -128,7 +135,7 @@ public:
     // 169(2), 374-390.
     // Method precondition and postcondition:
     // next_spk_time must be neither infinite nor negative
-    vector<spike_t> stochastic_spike_generation(unsigned long out_neu_idx, double input_val, CImg<double>::iterator next_spk_time_it, CImg<double>::iterator last_spk_time_it, CImg<double>::iterator curr_ref_period_it);
+    vector<spike_t> stochastic_spike_generation(unsigned long out_neu_idx, double input_val, CImg<double>::iterator next_spk_time_it, CImg<double>::iterator last_spk_time_it, CImg<double>::iterator curr_ref_period_it, RandomStream &rand_stream);
 
     // This method randomizes the state of the spike generator for all the outputs so that
     // each neuron will start firing at random times (from 0 to the initial firing period)
@@ -140,6 +147,9 @@ public:
     
     // Save the accumulated spike activity into a file
     bool SaveFile(string spk_filename);
+
+    // Get the spikes generated in the last simulation slot (used to send them to NEST)
+    const vector<spike_t>& getSlotSpikes(){return last_slot_spks;}
     
     // Get output image (y(k))
     virtual CImg<double>* getOutput();
@@ -1,27 +1,43 @@
 #include "StaticNonLinearity.h"
 
+#include <algorithm> // std::sort, std::upper_bound
+
 StaticNonLinearity::StaticNonLinearity(int x, int y, double temporal_step, int t):module(x,y,temporal_step){
     type = t;
     isThreshold = false;
-    
+
+    segmentsSorted = false;
+    LUTSize = 0;
+    LUTStart = 0.0;
+    LUTScale = 0.0;
+
     inputImage=new CImg<double> (sizeY,sizeX,1,1,0.0);
     outputImage=new CImg<double> (sizeY,sizeX,1,1,0.0);
-    markers=new CImg<double> (sizeY,sizeX,1,1,0.0);
 }
 
 StaticNonLinearity::StaticNonLinearity(const StaticNonLinearity& copy):module(copy){
     type = copy.type;
     isThreshold = copy.isThreshold;
-    
+
+    slope = copy.slope;
+    offset = copy.offset;
+    exponent = copy.exponent;
+    threshold = copy.threshold;
+    start = copy.start;
+    end = copy.end;
+
+    segmentsSorted = false;
+    LUTSize = copy.LUTSize;
+    LUTStart = 0.0;
+    LUTScale = 0.0;
+
     inputImage=new CImg<double>(*(copy.inputImage));
     outputImage=new CImg<double>(*(copy.outputImage));
-    markers=new CImg<double>(*(copy.markers));
 }
 
 StaticNonLinearity::~StaticNonLinearity(void){
     delete inputImage;
     delete outputImage;
-    delete markers;
 }
 
 //------------------------------------------------------------------------------//
@@ -49,15 +65,85 @@ void StaticNonLinearity::setType(int t){
     type = t;
 }
 
+bool StaticNonLinearity::setLUTSize(int n){
+    bool ret_correct;
+    if (n==0 || n>=2) {
+        LUTSize = n;
+        segmentsSorted = false;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
 //------------------------------------------------------------------------------//
 
 bool StaticNonLinearity::allocateValues(){
-    inputImage->assign(sizeY,sizeX,1,1,0.1);
-    outputImage->assign(sizeY,sizeX,1,1,0.1);
-    markers->assign(sizeY,sizeX,1,1,0.1);
+    inputImage->assign(sizeY,sizeX,batchSize,1,0.1);
+    outputImage->assign(sizeY,sizeX,batchSize,1,0.1);
+    if(type==1)
+        sortSegments();
     return(true);
 }
 
+//------------------------------------------------------------------------------//
+
+// The breakpoints of the piecewise function (start and end values of all the segments)
+// are sorted to split the input domain into intervals that do not contain any other
+// breakpoint. Each interval is evaluated by the first declared segment that covers it
+// (or not modified if no segment covers it), as when the segments are checked in order.
+void StaticNonLinearity::sortSegments(){
+    size_t n_segments = min(min(slope.size(),offset.size()),min(exponent.size(),min(start.size(),end.size())));
+
+    breakpoints.clear();
+    for(size_t k=0;k<n_segments;k++){
+        breakpoints.push_back(start[k]);
+        breakpoints.push_back(end[k]);
+    }
+    sort(breakpoints.begin(), breakpoints.end());
+    breakpoints.erase(unique(breakpoints.begin(), breakpoints.end()), breakpoints.end());
+
+    intervalSegment.assign(breakpoints.empty()? 0 : breakpoints.size()-1, -1);
+    for(size_t i=0;i<intervalSegment.size();i++){
+        for(size_t k=0;k<n_segments;k++){
+            if(breakpoints[i] >= start[k] && breakpoints[i] < end[k]){
+                intervalSegment[i] = (int)k;
+                break;
+            }
+        }
+    }
+
+    // Optional lookup table with linear interpolation over the domain of the segments
+    // (the last point takes the value of the function just before the last breakpoint,
+    // since the segments do not include their end values)
+    LUT.clear();
+    if(LUTSize > 0 && intervalSegment.size() > 0){
+        LUTStart = breakpoints.front();
+        LUTScale = (LUTSize-1)/(breakpoints.back()-breakpoints.front());
+        LUT.resize(LUTSize);
+        for(int j=0;j<LUTSize-1;j++)
+            LUT[j] = evalPiecewise(LUTStart + j/LUTScale);
+        LUT[LUTSize-1] = evalPiecewise(nextafter(breakpoints.back(), breakpoints.front()));
+    }
+
+    segmentsSorted = true;
+}
+
+double StaticNonLinearity::evalPiecewise(double value) const{
+    // index of the interval that contains the value (values outside the breakpoints or
+    // NaN are not modified)
+    long i = (long)(upper_bound(breakpoints.begin(), breakpoints.end(), value) - breakpoints.begin()) - 1;
+    if(i < 0 || i >= (long)intervalSegment.size())
+        return value;
+
+    int k = intervalSegment[i];
+    if(k < 0)
+        return value;
+    if(fastMath && !FastMath::isExactExponent(exponent[k]))
+        return FastMath::pow(value*slope[k] + offset[k], exponent[k]);
+    return pow(value*slope[k] + offset[k], exponent[k]);
+}
+
 void StaticNonLinearity::feedInput(double sim_time, const CImg<double>& new_input, bool isCurrent, int port){
     // copy input image
     *inputImage = new_input;
@@ -65,13 +151,18 @@ void StaticNonLinearity::feedInput(double sim_time, const CImg<double>& new_inpu
 
 void StaticNonLinearity::update(){  
 
+    // the approximations of FastMath are used for the exponents and sigmoids
+    if(fastMath && (type==2 || type==3 || (type==0 && !FastMath::isExactExponent(exponent[0])))){
+        updateFastMath();
+    }
+
     // polynomial function
-    if(type==0){
+    else if(type==0){
 
         if(isThreshold){
-            cimg_forXY((*inputImage),x,y) {
-                if((*inputImage)(x,y,0,0) < threshold[0])
-                    (*inputImage)(x,y,0,0) = threshold[0];
+            cimg_forXYZ((*inputImage),x,y,z) {
+                if((*inputImage)(x,y,z,0) < threshold[0])
+                    (*inputImage)(x,y,z,0) = threshold[0];
             }
         }
 
@@ -83,27 +174,38 @@ void StaticNonLinearity::update(){
 
     // piecewise function
     else if(type==1){
-            markers->fill(0.0);
-            for(size_t k=0;k<slope.size();k++){
-                cimg_forXY((*inputImage),x,y) {
-                    if((*inputImage)(x,y,0,0) >= start[k] && (*inputImage)(x,y,0,0) < end[k] && (*markers)(x,y,0,0)==0.0){
-                        (*inputImage)(x,y,0,0)*=slope[k];
-                        (*inputImage)(x,y,0,0)+=offset[k];
-                        (*inputImage)(x,y,0,0) = pow((*inputImage)(x,y,0,0),exponent[k]);
-                        (*markers)(x,y,0,0)=1.0;
-
-                    }
+        if(!segmentsSorted)
+            sortSegments();
+
+        double *values = inputImage->data();
+        const long n_pixels = (long)inputImage->size();
+
+        if(LUT.empty()){
+            #pragma omp parallel for if(n_pixels >= 16384)
+            for(long p=0;p<n_pixels;p++)
+                values[p] = evalPiecewise(values[p]);
+        }else{
+            const double LUT_end = breakpoints.back();
+            #pragma omp parallel for if(n_pixels >= 16384)
+            for(long p=0;p<n_pixels;p++){
+                double value = values[p];
+                if(value >= LUTStart && value < LUT_end){
+                    double pos = (value - LUTStart)*LUTScale;
+                    int j = (int)pos;
+                    if(j > LUTSize-2)
+                        j = LUTSize-2;
+                    values[p] = LUT[j] + (LUT[j+1] - LUT[j])*(pos - j);
                 }
-
             }
+        }
     }
 
     // Symmetric sigmoid (only for negative values)
     else if(type==2){
         double absVal = 0.0;
-        cimg_forXY((*inputImage),x,y) {
-            absVal = abs((*inputImage)(x,y,0,0));
-            (*inputImage)(x,y,0,0) = sgn<double>((*inputImage)(x,y,0,0))*(exponent[0] / (1.0 + exp(-absVal*slope[0] + offset[0])));
+        cimg_forXYZ((*inputImage),x,y,z) {
+            absVal = abs((*inputImage)(x,y,z,0));
+            (*inputImage)(x,y,z,0) = sgn<double>((*inputImage)(x,y,z,0))*(exponent[0] / (1.0 + exp(-absVal*slope[0] + offset[0])));
         }
 
     }
@@ -111,9 +213,9 @@ void StaticNonLinearity::update(){
     // Standard sigmoid
     else if(type==3){
         double value = 0.0;
-        cimg_forXY((*inputImage),x,y) {
-            value = (*inputImage)(x,y,0,0);
-            (*inputImage)(x,y,0,0) = (exponent[0] / (1.0 + exp(-value*slope[0] + offset[0])));
+        cimg_forXYZ((*inputImage),x,y,z) {
+            value = (*inputImage)(x,y,z,0);
+            (*inputImage)(x,y,z,0) = (exponent[0] / (1.0 + exp(-value*slope[0] + offset[0])));
         }
 
     }
@@ -121,6 +223,52 @@ void StaticNonLinearity::update(){
     *outputImage = *inputImage;
 }
 
+void StaticNonLinearity::updateFastMath(){
+    double *values = inputImage->data();
+    const long n_pixels = (long)inputImage->size();
+    const double s = slope[0], o = offset[0], e = exponent[0];
+
+    // polynomial function
+    if(type==0){
+        const double min_value = isThreshold? threshold[0] : -numeric_limits<double>::infinity();
+        #pragma omp parallel for simd if(n_pixels >= 16384)
+        for(long p=0;p<n_pixels;p++){
+            double value = values[p];
+            value = (value < min_value)? min_value : value;
+            values[p] = value*s + o;
+        }
+        FastMath::pow(values, n_pixels, e);
+    }
+
+    // Symmetric sigmoid (only for negative values): the exponentials are computed in the
+    // output image (copied from the input image by update()) so that the input keeps the signs
+    else if(type==2){
+        outputImage->assign(inputImage->width(),inputImage->height(),inputImage->depth(),inputImage->spectrum());
+        double *args = outputImage->data();
+        #pragma omp parallel for simd if(n_pixels >= 16384)
+        for(long p=0;p<n_pixels;p++)
+            args[p] = -fabs(values[p])*s + o;
+        FastMath::exp(args, n_pixels);
+        #pragma omp parallel for simd if(n_pixels >= 16384)
+        for(long p=0;p<n_pixels;p++){
+            double sign = (values[p] > 0.0)? 1.0 : 0.0;
+            sign = (values[p] < 0.0)? -1.0 : sign;
+            values[p] = sign*(e / (1.0 + args[p]));
+        }
+    }
+
+    // Standard sigmoid
+    else if(type==3){
+        #pragma omp parallel for simd if(n_pixels >= 16384)
+        for(long p=0;p<n_pixels;p++)
+            values[p] = -values[p]*s + o;
+        FastMath::exp(values, n_pixels);
+        #pragma omp parallel for simd if(n_pixels >= 16384)
+        for(long p=0;p<n_pixels;p++)
+            values[p] = e / (1.0 + values[p]);
+    }
+}
+
 //------------------------------------------------------------------------------//
 
 int StaticNonLinearity::setParameters(vector<double> params, vector<string> paramID){
@@ -148,10 +296,15 @@ int StaticNonLinearity::setParameters(vector<double> params, vector<string> para
         else if (strcmp(s,"end")==0){
             end.push_back(params[i]);
         }
+        else if (strcmp(s,"LUT_size")==0){
+            if(!setLUTSize((int)params[i]))
+                err_param_num = -(i+1);
+        }
         else{
               err_param_num = i+1;
         }
     }
+    segmentsSorted = false;
 
     return err_param_num;
 }
@@ -179,6 +332,7 @@ void StaticNonLinearity::clearParameters(vector<string> paramID){
             end.clear();
         }
     }
+    segmentsSorted = false;
 }
 
 //------------------------------------------------------------------------------//
@@ -188,6 +342,10 @@ CImg<double>* StaticNonLinearity::getOutput(){
     return outputImage;
 }
 
+bool StaticNonLinearity::isStateless(){
+    return true;
+}
+
 //------------------------------------------------------------------------------//
 
 template <typename T> int StaticNonLinearity::sgn(T val) {
@@ -4,7 +4,11 @@
 /* BeginDocumentation
  * Name: StaticNonLinearity
  *
- * Description: Static nonlinearity
+ * Description: Static nonlinearity. Type 0 is a polynomial function, type 1 (CustomNonLinearity)
+ * a piecewise function of segments [start,end), type 2 a symmetric sigmoid and type 3 a sigmoid.
+ * The piecewise function is evaluated with a binary search of the sorted segment breakpoints
+ * or, if LUT_size is set, with a lookup table of LUT_size points (linear interpolation, which
+ * smooths the discontinuities between segments over one table interval).
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -16,6 +20,7 @@
 #include <iostream>
 #include "vector"
 #include "module.h"
+#include "FastMath.h"
 
 using namespace cimg_library;
 using namespace std;
@@ -38,10 +43,27 @@ protected:
 
     bool isThreshold;
 
+    // sorted breakpoints of the piecewise function and segment that evaluates each
+    // interval between breakpoints (-1 if the values are not modified)
+    vector <double> breakpoints;
+    vector <int> intervalSegment;
+    bool segmentsSorted;
+
+    // lookup table of the piecewise function (LUTSize = 0 if it is not used)
+    int LUTSize;
+    vector <double> LUT;
+    double LUTStart,LUTScale;
+
     // buffers
     CImg<double> *inputImage;
     CImg<double> *outputImage;
-    CImg<double> *markers;
+
+    // fast math versions of the functions (see FastMath)
+    void updateFastMath();
+
+    // piecewise function
+    void sortSegments();
+    double evalPiecewise(double value) const;
 
 public:
     // Constructor, copy, destructor.
@@ -55,6 +77,7 @@ public:
     void setExponent(double e=1.0, int segment=0);
     void setThreshold(double t=0.0, int segment=0);
     void setType(int t);
+    bool setLUTSize(int n);
 
     // Allocate values
     virtual bool allocateValues();
@@ -66,6 +89,8 @@ public:
     virtual void clearParameters(vector<string> paramID);
     // Get output image (y(k))
     virtual CImg<double>* getOutput();
+    // The nonlinearity is applied to each input value independently
+    virtual bool isStateless();
     // aux. func.
     template <typename T> int sgn(T val);
 };
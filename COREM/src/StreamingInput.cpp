@@ -110,6 +110,7 @@ bool StreamingInput::allocateValues(){
             
         // Use the first frame to find out the new dimensions of retina image size
         outputImage->load_png(receiver_vars.accept_socket_fh); // Get first valid frame
+        outputVersion++;
         sizeY=outputImage->width();
         sizeX=outputImage->height();
         NextFrameTime=InputFramePeriod; // Next frame must be read at this time
@@ -196,6 +197,7 @@ void StreamingInput::get_new_frame(){
 
     if(receiver_vars.buffer_img != NULL) {
         *outputImage = *receiver_vars.buffer_img; // Get output from buffer
+        outputVersion++;
         pthread_mutex_unlock(&receiver_vars.reception_mutex); // Signal the receiver thread that it can update the value of buffer_img buffer with a new frame
     } else { // End of stream
         if(!endOfInput && !RepeatLastFrame){
@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include "corem_api.h"
+#include "RetinaInterface.h"
+#include "BufferInput.h"
+
+struct corem_retina{
+    RetinaInterface retinaInterface;
+    std::string scriptPath; // The file reader keeps a pointer to the path
+    std::vector<std::string> moduleIDs; // Storage of the strings returned by corem_module_id()
+    bool loaded;
+};
+
+//------------------------------------------------------------------------------//
+
+corem_retina *corem_create(void){
+    corem_retina *retina = new corem_retina;
+    retina->retinaInterface.setVerbosity(false);
+    retina->retinaInterface.setSkipUnreachable(false); // The output of any module can be read
+    retina->loaded = false;
+    return(retina);
+}
+
+void corem_destroy(corem_retina *retina){
+    delete retina;
+}
+
+//------------------------------------------------------------------------------//
+
+// The IDs are stored once the retina is loaded, so that the returned strings remain valid
+static int finish_loading(corem_retina *retina, bool ret_correct){
+    Retina &r = retina->retinaInterface.getRetina();
+
+    retina->moduleIDs.clear();
+    for(int k=0;k<r.getNumberModules();k++)
+        retina->moduleIDs.push_back(r.getModule(k)->getModuleID());
+    retina->loaded = ret_correct;
+    return(ret_correct? 1 : 0);
+}
+
+int corem_load_file(corem_retina *retina, const char *script_path){
+    retina->retinaInterface.reset(1, 1, 1.0, 1);
+    retina->scriptPath = script_path;
+    return(finish_loading(retina, retina->retinaInterface.allocateValues(retina->scriptPath.c_str(), "", 1.0, 0)));
+}
+
+int corem_load_script(corem_retina *retina, const char *script_text){
+    retina->retinaInterface.reset(1, 1, 1.0, 1);
+    return(finish_loading(retina, retina->retinaInterface.loadScript(script_text, 0)));
+}
+
+//------------------------------------------------------------------------------//
+
+int corem_size_x(corem_retina *retina){
+    return(retina->retinaInterface.getRetina().getSizeX());
+}
+
+int corem_size_y(corem_retina *retina){
+    return(retina->retinaInterface.getRetina().getSizeY());
+}
+
+int corem_batch_size(corem_retina *retina){
+    return(retina->retinaInterface.getRetina().getBatchSize());
+}
+
+double corem_time_step(corem_retina *retina){
+    return(retina->retinaInterface.getRetina().getStep());
+}
+
+int corem_total_time(corem_retina *retina){
+    return(retina->retinaInterface.getTotalSimTime());
+}
+
+int corem_current_time(corem_retina *retina){
+    return(retina->retinaInterface.getSimTime());
+}
+
+//------------------------------------------------------------------------------//
+
+int corem_push_frame(corem_retina *retina, double *frame, long n_values){
+    BufferInput *input = NULL;
+
+    if(retina->loaded)
+        input = dynamic_cast<BufferInput*>(retina->retinaInterface.getRetina().getModule(0));
+    return((input != NULL && input->setBuffer(frame, n_values))? 1 : 0);
+}
+
+int corem_input_channels(corem_retina *retina){
+    BufferInput *input = NULL;
+
+    if(retina->loaded)
+        input = dynamic_cast<BufferInput*>(retina->retinaInterface.getRetina().getModule(0));
+    return((input != NULL)? input->getChannels() : 0);
+}
+
+int corem_step(corem_retina *retina, int n){
+    int n_steps = 0;
+
+    // The simulation ends at the simulation time of the script or at the end of the input
+    while(retina->loaded && n_steps < n && !retina->retinaInterface.getAbortExecution() &&
+          retina->retinaInterface.getSimTime() < retina->retinaInterface.getTotalSimTime()){
+        retina->retinaInterface.update();
+        n_steps++;
+    }
+    return(n_steps);
+}
+
+//------------------------------------------------------------------------------//
+
+int corem_number_modules(corem_retina *retina){
+    return((int)retina->moduleIDs.size());
+}
+
+int corem_module_handle(corem_retina *retina, const char *module_id){
+    int handle = -1;
+
+    for(size_t k=0;k<retina->moduleIDs.size() && handle < 0;k++)
+        if(retina->moduleIDs[k] == module_id)
+            handle = (int)k;
+    return(handle);
+}
+
+const char *corem_module_id(corem_retina *retina, int handle){
+    const char *module_id = NULL;
+
+    if(handle >= 0 && (size_t)handle < retina->moduleIDs.size())
+        module_id = retina->moduleIDs[handle].c_str();
+    return(module_id);
+}
+
+const double *corem_module_output(corem_retina *retina, int handle, int *width, int *height, int *channels){
+    CImg<double> *output = NULL;
+
+    if(handle >= 0 && (size_t)handle < retina->moduleIDs.size())
+        output = retina->retinaInterface.getRetina().getModule(handle)->getOutput();
+
+    if(width != NULL) *width = (output != NULL)? output->width() : 0;
+    if(height != NULL) *height = (output != NULL)? output->height() : 0;
+    if(channels != NULL) *channels = (output != NULL)? output->spectrum() : 0;
+    return((output != NULL)? output->data() : NULL);
+}
+
+int corem_output_values(corem_retina *retina, long first, long count, double *values){
+    return(retina->retinaInterface.getValues(first, count, values));
+}
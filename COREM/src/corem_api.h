@@ -0,0 +1,78 @@
+#ifndef COREM_API_H
+#define COREM_API_H
+
+/* BeginDocumentation
+ * Name: corem_api
+ *
+ * Description: C interface of the COREM library (libcorem, built with "make lib") used to
+ * embed the retina in other programs and simulators without files, sockets or copies.
+ * A retina is created, loaded from a script (file or text), fed with frames and advanced
+ * step by step, and the output image of any module can be read through a handle (index
+ * of the module in the retina). All the modules are simulated, even if their output does not
+ * reach an Output module.
+ *
+ * Input frames are pushed to a buffer input declared in the script, for example:
+ *   retina.Input('buffer',{'sizeX','64','sizeY','64','channels','1'})
+ * The frame buffer is used by the retina without copying it, so it must remain valid
+ * until the next frame is pushed. Frames and module outputs are stored as CImg images:
+ * channel by channel and row by row, with width (sizeY) pixels per row. In batch mode
+ * (script command BatchSize) each channel contains the images of all the stimuli of the
+ * batch, one after another.
+ *
+ * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
+ * <pablomc@ugr.es>
+ *
+ * SeeAlso: RetinaInterface, BufferInput
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct corem_retina corem_retina;
+
+/* Create and destroy a retina (NULL on error) */
+corem_retina *corem_create(void);
+void corem_destroy(corem_retina *retina);
+
+/* Load a retina script from a file or from its text. Return 1 on success and 0 on error */
+int corem_load_file(corem_retina *retina, const char *script_path);
+int corem_load_script(corem_retina *retina, const char *script_text);
+
+/* Retina size (sizeX = height, sizeY = width), time step (ms), simulation time (ms) and current time (ms) */
+int corem_size_x(corem_retina *retina);
+int corem_size_y(corem_retina *retina);
+double corem_time_step(corem_retina *retina);
+int corem_total_time(corem_retina *retina);
+int corem_current_time(corem_retina *retina);
+/* Number of stimuli simulated in one pass (1 if the script does not set BatchSize) */
+int corem_batch_size(corem_retina *retina);
+
+/* Push a new input frame of n_values values (sizeX*sizeY*batch_size*channels, zero-copy). Return 1 on
+   success and 0 if the script does not declare a buffer input or n_values is not the frame size */
+int corem_push_frame(corem_retina *retina, double *frame, long n_values);
+/* Number of channels of the frames of the buffer input (0 if the script does not declare it) */
+int corem_input_channels(corem_retina *retina);
+
+/* Simulate n steps. Return the number of steps simulated (less than n at the end of the simulation
+   time or of the input) */
+int corem_step(corem_retina *retina, int n);
+
+/* Module handles: number of modules, handle of a module ID (-1 if not found) and ID of a handle */
+int corem_number_modules(corem_retina *retina);
+int corem_module_handle(corem_retina *retina, const char *module_id);
+const char *corem_module_id(corem_retina *retina, int handle);
+
+/* Output image of a module: pointer to its values, valid until the next step (NULL if the module
+   has no output). The image dimensions are returned in width, height and channels (if not NULL) */
+const double *corem_module_output(corem_retina *retina, int handle, int *width, int *height, int *channels);
+
+/* Values of count consecutive cells of the Output module layers (as in NEST), -1 outside them.
+   Return the number of cells inside the layers */
+int corem_output_values(corem_retina *retina, long first, long count, double *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COREM_API_H
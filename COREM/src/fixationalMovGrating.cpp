@@ -1,19 +1,7 @@
 #include "fixationalMovGrating.h"
 
 fixationalMovGrating::fixationalMovGrating(int X,int Y,double radius,double jitter,double period,double step,double luminance,double contrast,double orientation,double red_weight,double green_weigh, double blue_weight,int t1,int t2,int ts)
-{  
-    unsigned seed1,seed2,seed3,seed4;
-    seed1 = std::chrono::system_clock::now().time_since_epoch().count();
-    seed3 = std::chrono::system_clock::now().time_since_epoch().count();
-
-    // Fixed seed to lower processing time when optimizing parameters:
-    // it is not necessary to average several trials, only one trial
-    // per individual to optimize. Random distributions wouldn't be used
-//    seed1 = 10;
-//    seed2 = 20;
-//    seed3 = 30;
-//    seed4 = 40;
-
+{
     sizeX = X;
     sizeY = Y;
     type1 = t1;
@@ -35,38 +23,17 @@ fixationalMovGrating::fixationalMovGrating(int X,int Y,double radius,double jitt
     cos_theta=cos(theta);
     sin_theta=sin(theta);
     A=Cont*Lum;
-    aux = *(new CImg <double>(Y,X,1,3));
-
-
-    generator1 = *(new default_random_engine(seed1));
-    distribution1 = *(new normal_distribution<double>(0.0,step_size));
-
-    if(type1 == 0){
-        seed2 = std::chrono::system_clock::now().time_since_epoch().count();
-    }else{
-        seed2 = seed1;
-    }
-
-    generator2 = *(new default_random_engine(seed2));
-    distribution2 = *(new normal_distribution<double>(0.0,step_size));
-
-
-    generator3 = *(new default_random_engine(seed3));
-
-    if(type2 == 0){
-        seed4 = std::chrono::system_clock::now().time_since_epoch().count();
-    }else{
-        seed4 = seed3;
-    }
+    aux.assign(Y,X,1,1); // Luminance image (the channel weights are applied by the retina)
 
-    generator4 = *(new default_random_engine(seed4));
 
+    streamsInitialized = false;
+    frameVersion = 0;
 
     Pi = 3.14159265;
     jitter1 = 0.0;
     jitter2 = 0.0;
     j1 = -step_size;
-    value1=value2=value3 = 0.0;
+    value1 = 0.0;
 }
 
 fixationalMovGrating::fixationalMovGrating(const fixationalMovGrating& copy){
@@ -79,13 +46,30 @@ fixationalMovGrating::~fixationalMovGrating(void){
 
 //------------------------------------------------------------------------------//
 
+// Jitters are reproducible for a given seed and trial (see CounterRNG)
+void fixationalMovGrating::initializeStreams(){
+    uint64_t key = CounterRNG::streamKey("fixationalMovGrating");
+
+    stream1.seed(key, 0);
+    stream2.seed(key, (type1 == 0)? 1 : 0);
+    stream3.seed(key, 2);
+    stream4.seed(key, (type2 == 0)? 3 : 2);
+    streamsInitialized = true;
+}
+
+//------------------------------------------------------------------------------//
+
 CImg <double>* fixationalMovGrating::compute_grating(double t){
 
     if((int)t%(int)jitter_period == 0){
 
+        if(!streamsInitialized)
+            initializeStreams();
+        frameVersion++;
+
         if(t < tswitch){
-            j1 = distribution1(generator1);
-            j2 = distribution2(generator2);
+            j1 = stream1.normal(0.0,step_size);
+            j2 = stream2.normal(0.0,step_size);
 
             // shift fixed
 //            if(type1 == 0){
@@ -97,8 +81,8 @@ CImg <double>* fixationalMovGrating::compute_grating(double t){
 //            }
 
         }else{
-            j1 = distribution1(generator3);
-            j2 = distribution2(generator4);
+            j1 = stream3.normal(0.0,step_size);
+            j2 = stream4.normal(0.0,step_size);
 
             // shift fixed
 //            if(type2 == 0){
@@ -119,19 +103,12 @@ CImg <double>* fixationalMovGrating::compute_grating(double t){
 
            radius = sqrt((double(x) - double(x0))*(double(x) - double(x0)) + (double(y) - double(y0))*(double(y) - double(y0)));
 
-           if(radius < circle_radius){
-               value3 = b*Lum + b * A *cos(Pi/2 +  (((x-x0+jitter1)*cos_theta+(y-y0+jitter1)*sin_theta)/spatial_period)*2*Pi);
-               value2 = g*Lum + g * A *cos(Pi/2 +   (((x-x0+jitter1)*cos_theta+(y-y0+jitter1)*sin_theta)/spatial_period)*2*Pi);
-               value1 = r*Lum + r * A *cos(Pi/2 +   (((x-x0+jitter1)*cos_theta+(y-y0+jitter1)*sin_theta)/spatial_period)*2*Pi);
-           }else{
-               value3 = b*Lum + b * A *cos(Pi/2 +   (((x-x0+jitter2)*cos_theta+(y-y0+jitter2)*sin_theta)/spatial_period)*2*Pi);
-               value2 = g*Lum + g * A *cos(Pi/2 +   (((x-x0+jitter2)*cos_theta+(y-y0+jitter2)*sin_theta)/spatial_period)*2*Pi);
-               value1 = r*Lum + r * A *cos(Pi/2 +   (((x-x0+jitter2)*cos_theta+(y-y0+jitter2)*sin_theta)/spatial_period)*2*Pi);
-           }
-
-               aux(x,y,0,0)=value1;
-               aux(x,y,0,1)=value2;
-               aux(x,y,0,2)=value3;
+           if(radius < circle_radius)
+               value1 = Lum + A *cos(Pi/2 +  (((x-x0+jitter1)*cos_theta+(y-y0+jitter1)*sin_theta)/spatial_period)*2*Pi);
+           else
+               value1 = Lum + A *cos(Pi/2 +   (((x-x0+jitter2)*cos_theta+(y-y0+jitter2)*sin_theta)/spatial_period)*2*Pi);
+
+           aux(x,y,0,0)=value1;
        }
 
     }
@@ -140,3 +117,15 @@ CImg <double>* fixationalMovGrating::compute_grating(double t){
 }
 
 //------------------------------------------------------------------------------//
+
+double fixationalMovGrating::getChannelGain(int channel){
+    double gain;
+
+    if(channel == 0)
+        gain = r;
+    else if(channel == 1)
+        gain = g;
+    else
+        gain = b;
+    return(gain);
+}
@@ -4,7 +4,8 @@
 /* BeginDocumentation
  * Name: fixationalMovGrating
  *
- * Description: jittered grating used to reproduce motion adaptation [1,2]
+ * Description: jittered grating used to reproduce motion adaptation [1,2]. The grating is
+ * generated as a single-channel luminance image and the retina applies the color weights.
  *
  * [1] Ölveczky, Bence P., Stephen A. Baccus, and Markus Meister. "Segregation
  * of object and background motion in the retina." Nature 423.6938 (2003): 401-408.
@@ -20,8 +21,7 @@
 
 #include "../CImg-1.6.0_rolling141127/CImg.h"
 
-#include <random>
-#include <chrono>
+#include "CounterRNG.h"
 
 using namespace cimg_library;
 using namespace std;
@@ -49,13 +49,17 @@ protected:
 
     int x0,y0;
 
-    // Normal distributions for each interval (one for centre and one for periphery)
-    normal_distribution<double> distribution1,distribution2;
-    default_random_engine generator1,generator2,generator3,generator4;
+    // Random streams for each interval (one for centre and one for periphery). The
+    // periphery shares the stream of the centre when they move together (type = 1)
+    RandomStream stream1,stream2,stream3,stream4;
+    bool streamsInitialized;
+
+    void initializeStreams();
 
     // aux variables to update the grating
     CImg <double> aux;
-    double Pi,jitter1,jitter2,radius,value1,value2,value3,j1,j2;
+    unsigned long frameVersion; // version of the grating image (it changes after each jitter)
+    double Pi,jitter1,jitter2,radius,value1,j1,j2;
 
 public:
     // Constructor, copy, destructor.
@@ -65,6 +69,12 @@ public:
 
     // update the grating
     CImg<double> *compute_grating(double t);
+
+    // version of the grating image
+    unsigned long getFrameVersion(){return frameVersion;}
+
+    // gain of a color channel (0: red, 1: green, 2: blue) with respect to the luminance grating image
+    double getChannelGain(int channel);
 };
 
 #endif // FIXATIONALMOVGRATING_H
@@ -5,14 +5,10 @@ impulse::impulse(double startParam, double stopParam, double amplitudeParam, dou
     stop = stopParam;
     amplitude = amplitudeParam;
     offset = offsetParam;
+    lastState = -1;
+    frameVersion = 0;
 
-    output = new CImg <double>(Y,X,1,3);
-
-    cimg_forXY(*output,x,y) {
-        (*output)(x,y,0,0) = 1.0,
-        (*output)(x,y,0,1) = 1.0,
-        (*output)(x,y,0,2) = 1.0;
-    }
+    output = new CImg <double>(Y,X,1,1,1.0); // Luminance image
 }
 
 impulse::impulse(const impulse& copy){
@@ -26,22 +22,17 @@ impulse::~impulse(void){
 //------------------------------------------------------------------------------//
 
 CImg<double>* impulse::update(double t){
+    int state = (t>=start && t <=stop)? 1 : 0;
 
+    if(state != lastState){
+        lastState = state;
+        frameVersion++;
 
-    if(t>=start && t <=stop){
-        cimg_forXY(*output,x,y) {
-            (*output)(x,y,0,0) = amplitude + offset,
-            (*output)(x,y,0,1) = amplitude + offset,
-            (*output)(x,y,0,2) = amplitude + offset;
-        }
-    }else{
-        cimg_forXY(*output,x,y) {
-            (*output)(x,y,0,0) = offset,
-            (*output)(x,y,0,1) = offset,
-            (*output)(x,y,0,2) = offset;
-        }
+        if(state == 1)
+            output->fill(amplitude + offset);
+        else
+            output->fill(offset);
     }
 
-
     return output;
 }
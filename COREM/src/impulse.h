@@ -4,7 +4,7 @@
 /* BeginDocumentation
  * Name: impulse
  *
- * Description: impulse generator.
+ * Description: impulse generator. The output is a single-channel luminance image.
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -26,8 +26,11 @@ private:
     double amplitude;
     double offset;
 
-    // Output image
+    // Output image (a single luminance channel)
     CImg <double> *output;
+    // The output changes when the impulse starts or stops
+    int lastState;
+    unsigned long frameVersion;
 
 public:
     // Constructor, copy, destructor.
@@ -38,6 +41,9 @@ public:
 
     // update
     CImg<double>* update(double t);
+
+    // version of the output image (it changes when the output image changes)
+    unsigned long getFrameVersion(){return frameVersion;}
 };
 
 #endif // IMPULSE_H
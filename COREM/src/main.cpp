@@ -21,6 +21,51 @@ using namespace std;
 
 #define MULT_OUT_FILENAME_TAIL "_output_multimeter.txt"
 
+// Simulate the first trial of the retina script with the exact computations and with the
+// approximations of FastMath at the same time, and print the maximum error of each module
+// output (absolute and relative to the maximum absolute value of the exact output)
+bool validateFastMath(const char *retinaSim, bool verbose_flag){
+    RetinaInterface exact_interface, fast_interface;
+    exact_interface.setVerbosity(verbose_flag);
+    exact_interface.setFastMath(false);
+    fast_interface.setFastMath(true);
+    if(!exact_interface.allocateValues(retinaSim, MULT_OUT_FILENAME_TAIL, constants::outputfactor, 0) ||
+       !fast_interface.allocateValues(retinaSim, MULT_OUT_FILENAME_TAIL, constants::outputfactor, 0))
+        return(false);
+
+    Retina &exact_retina = exact_interface.getRetina();
+    Retina &fast_retina = fast_interface.getRetina();
+    int n_modules = exact_retina.getNumberModules();
+    vector<double> max_error(n_modules, 0.0), max_value(n_modules, 0.0);
+
+    int totalSimTime = exact_interface.getTotalSimTime();
+    double simStep = exact_interface.getSimStep();
+    for(int sim_time=0;!exact_interface.getAbortExecution() && !fast_interface.getAbortExecution() && sim_time<totalSimTime;sim_time+=simStep){
+        exact_interface.update();
+        fast_interface.update();
+
+        for(int k=0;k<n_modules;k++){
+            CImg<double> *exact_output = exact_retina.getModule(k)->getOutput();
+            CImg<double> *fast_output = fast_retina.getModule(k)->getOutput();
+            if(exact_output == NULL || fast_output == NULL || exact_output->size() != fast_output->size())
+                continue;
+            const double *e = exact_output->data(), *f = fast_output->data();
+            for(size_t i=0;i<exact_output->size();i++){
+                max_error[k] = max(max_error[k], fabs(f[i] - e[i]));
+                max_value[k] = max(max_value[k], fabs(e[i]));
+            }
+        }
+    }
+
+    cout << "Fast math error (maximum absolute and relative error of each module output):" << endl;
+    for(int k=0;k<n_modules;k++){
+        string ID = exact_retina.getModule(k)->getModuleID();
+        cout << "  " << ID << string(ID.size() < 30? 30-ID.size() : 1, ' ') << max_error[k] << "\t";
+        cout << ((max_value[k] > 0.0)? max_error[k]/max_value[k] : 0.0) << endl;
+    }
+    return(true);
+}
+
 // main
 int main(int argc, char *argv[])
 {
@@ -67,10 +112,13 @@ int main(int argc, char *argv[])
     string retinaString;
     int arg_index;
     bool got_script_file;
-    bool verbose_flag, help_param, show_progress;
+    bool verbose_flag, help_param, show_progress, profile_flag, fast_math_flag, validate_flag;
 
     // Default parameter values
     verbose_flag=false;
+    profile_flag=false;
+    fast_math_flag=false;
+    validate_flag=false;
     show_progress=false;
     help_param=false;
     got_script_file=false;
@@ -85,11 +133,18 @@ int main(int argc, char *argv[])
         } else {
             if(strcmp(argv[arg_index],"-h") == 0 || strcmp(argv[arg_index],"--help") == 0){ // Help argument found
                 cout << "COREM retina simulator." << endl;
-                cout << " Syntax: " << argv[0] << " [-v] [-p] <retina_script_filename>" << endl;
+                cout << " Syntax: " << argv[0] << " [-v] [-p] [-P] [-f] [-V] <retina_script_filename>" << endl;
                 cout << "   <retina_script_filename> is a text file (usually with extension .py) which" << endl;
                 cout << "   defines a retina model and simulation parameters." << endl;
                 cout << "   -v argument shows verbose information." << endl;
                 cout << "   -p argument shows progress information during simulation." << endl;
+                cout << "   -P argument profiles the simulation: a table with the time spent by each" << endl;
+                cout << "   module is shown at the end and it is saved in results/profile.json (and" << endl;
+                cout << "   in results/profile_trace.json as a Chrome trace)." << endl;
+                cout << "   -f argument enables the fast math approximations of the nonlinear modules" << endl;
+                cout << "   (as the script command retina.FastMath('True'))." << endl;
+                cout << "   -V argument validates the fast math approximations: the first trial is" << endl;
+                cout << "   simulated with and without them and the error of each module is shown." << endl;
                 cout << "   Visit https://github.com/pablomc88/COREM/wiki for information about the" << endl;
                 cout << "   format of this script file" << endl;
                 help_param=true;
@@ -97,15 +152,25 @@ int main(int argc, char *argv[])
                 verbose_flag=true;
             else if(strcmp(argv[arg_index],"-p") == 0) // Progress information requested
                 show_progress=true;
+            else if(strcmp(argv[arg_index],"-P") == 0) // Profiling requested
+                profile_flag=true;
+            else if(strcmp(argv[arg_index],"-f") == 0) // Fast math requested
+                fast_math_flag=true;
+            else if(strcmp(argv[arg_index],"-V") == 0) // Validation of fast math requested
+                validate_flag=true;
             else
                 cout << "Ignoring unknown argument " << argv[arg_index] << endl;
         }
     }
-    if(got_script_file){
+    if(got_script_file && validate_flag){
+        if(!validateFastMath(retinaString.c_str(), verbose_flag))
+            cout << "Incorrect parameter/value specified or resorce allocation. Aborting." << endl;
+    }else if(got_script_file){
         // Create interface
-        int trial_ind, totalSimTime;
-        double simStep, num_trials;
+        int trial_ind, totalSimTime = 0;
+        double simStep = 1.0, num_trials = 1.0;
         const char *retinaSim = retinaString.c_str();
+        Profiler profiler; // Accumulates the profile of all trials
 
         // Simulation
         // Using a do loop we ensure that the RetinaInterface is created at least one time, and
@@ -115,6 +180,10 @@ int main(int argc, char *argv[])
             // Create new retina interface for every trial (reset values)
             RetinaInterface interface;
             interface.setVerbosity(verbose_flag);
+            if(fast_math_flag)
+                interface.setFastMath(true);
+            if(profile_flag)
+                interface.setProfiler(&profiler);
             if(!interface.allocateValues(retinaSim, MULT_OUT_FILENAME_TAIL, constants::outputfactor, trial_ind)) {
                 cout << "Incorrect parameter/value specified or resorce allocation. Aborting." << endl;
                 break;
@@ -145,7 +214,15 @@ int main(int argc, char *argv[])
             }
             if(show_progress)
                 cout << endl;
+            if(verbose_flag)
+                interface.getRetina().printSkippedUpdates();
         } while(++trial_ind < num_trials); // Check the loop end condition in the end, after reading the number of trials
+
+        if(profile_flag){
+            profiler.printTable();
+            profiler.saveJSON(resdir+"profile.json");
+            profiler.saveChromeTrace(resdir+"profile_trace.json");
+        }
         
     }else{
         if(!help_param){
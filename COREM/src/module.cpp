@@ -6,12 +6,25 @@ module::module(int x, int y, double temporal_step){
     step = temporal_step;
     sizeX = x;
     sizeY = y;
+    outputVersion = 0;
+    fastMath = false;
+    updatePeriod = 1;
+    interpolateOutput = false;
+    downsample = 1;
+    batchSize = 1;
 }
 
 module::module(const module& copy){
     step = copy.step;
     sizeX = copy.sizeX;
     sizeY = copy.sizeY;
+    outputVersion = copy.outputVersion;
+    fastMath = copy.fastMath;
+    updatePeriod = copy.updatePeriod;
+    interpolateOutput = copy.interpolateOutput;
+    downsample = copy.downsample;
+    batchSize = copy.batchSize;
+    signature = copy.signature;
 }
 
 module::~module(void){
@@ -23,6 +36,14 @@ bool module::allocateValues(){
     return(true);
     }
 
+unsigned long module::getOutputVersion(){
+    return(outputVersion);
+}
+
+void module::newOutputVersion(){
+    outputVersion++;
+}
+
 double module::getSizeX(){
     return(sizeX);
 }
@@ -61,6 +82,65 @@ bool module::set_step(double temporal_step) {
     return(ret_correct);
 }
 
+void module::setFastMath(bool fast_flag){
+    fastMath = fast_flag;
+}
+
+bool module::getFastMath(){
+    return(fastMath);
+}
+
+bool module::setUpdatePeriod(int period){
+    bool ret_correct;
+    if (period>0){
+        step = step/updatePeriod*period;
+        updatePeriod = period;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+int module::getUpdatePeriod(){
+    return(updatePeriod);
+}
+
+void module::setInterpolateOutput(bool interp_flag){
+    interpolateOutput = interp_flag;
+}
+
+bool module::getInterpolateOutput(){
+    return(interpolateOutput);
+}
+
+bool module::setDownsample(int factor){
+    bool ret_correct;
+    if (factor>0){
+        downsample = factor;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+int module::getDownsample(){
+    return(downsample);
+}
+
+bool module::setBatchSize(int batch_size){
+    bool ret_correct;
+    if (batch_size>0){
+        batchSize = batch_size;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
+
+int module::getBatchSize(){
+    return(batchSize);
+}
+
 void module::addOperation(vector <int> ops){
     portArith.push_back(ops);
     }
@@ -93,6 +173,14 @@ string module::getModuleID(){
     return ID;
     }
 
+void module::setSignature(string s){
+    signature=s;
+    }
+
+string module::getSignature(){
+    return signature;
+    }
+
 // Set and get synapse type
 void module::addTypeSynapse(int type){
     typeSynapse.push_back(type);
@@ -116,6 +204,10 @@ bool module::isDummy() {
     return true;
     }
 
+bool module::isStateless() {
+    return false;
+    }
+
 // Fn definitions just to avoid errors/warnings
 void module::feedInput(double sim_time, const CImg<double>& new_input, bool isCurrent, int port){
     }
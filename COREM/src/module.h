@@ -6,7 +6,14 @@
  * Name: module
  *
  * Description: base class of retina structure. GaussFilter, LinearFilter, ShortTermPlasticity,
- * SingleCompartment and StaticNonLinearity inherit from module
+ * SingleCompartment and StaticNonLinearity inherit from module. The modules created in the
+ * retina script accept the parameters updateEvery (number of simulation steps between updates
+ * of the module, which is simulated with a step of updateEvery times the simulation step) and
+ * interpolate (if not 0, the modules connected to it read the linear interpolation of its
+ * output between updates instead of the last output), and downsample (integer factor by which
+ * the grid of the module is reduced with respect to the input grid; the connections between
+ * grids of different size are resampled by the retina). In batch mode all the images have one
+ * slice (depth) per stimulus of the batch
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
@@ -32,6 +39,21 @@ protected:
     double simTime;
     // module ID
     string ID;
+    // Number of times the output image has changed (only updated by modules which can keep their output)
+    unsigned long outputVersion;
+    // Use the approximations of FastMath in the nonlinear computations
+    bool fastMath;
+    // Number of simulation steps between updates of the module (the step of the module is
+    // updatePeriod times the simulation step) and linear interpolation of its output between updates
+    int updatePeriod;
+    bool interpolateOutput;
+    // Factor by which the grid of the module is reduced with respect to the input grid
+    int downsample;
+    // Number of stimuli simulated at the same time (depth of the images)
+    int batchSize;
+    // Type and parameters with which the module was created by the retina script (empty if they
+    // are unknown): modules with the same signature and inputs compute the same output
+    string signature;
 
     // input modules and arithmetic operations for them
     vector <vector <int> > portArith;
@@ -51,6 +73,20 @@ public:
     bool setSizeX(int x);
     bool setSizeY(int y);
     bool set_step(double temporal_step); // Set the duration of a simulation time step (slot) in milliseconds
+    void setFastMath(bool fast_flag);
+    bool getFastMath();
+    // The update period must be set before the parameters which depend on the step
+    bool setUpdatePeriod(int period);
+    int getUpdatePeriod();
+    void setInterpolateOutput(bool interp_flag);
+    bool getInterpolateOutput();
+    // The downsampling factor must be set before the parameters which depend on the pixel size.
+    // The retina sets the size of the module grid
+    virtual bool setDownsample(int factor);
+    int getDownsample();
+    // Set by the retina before allocateValues()
+    bool setBatchSize(int batch_size);
+    int getBatchSize();
 
     // add operations or ID of input modules
     void addOperation(vector <int> ops);
@@ -66,12 +102,21 @@ public:
     void setModuleID(string s);
     string getModuleID();
 
+    // Set and get the creation signature of the module
+    void setSignature(string s);
+    string getSignature();
+
     // Set and get synapse type
     void addTypeSynapse(int type);
     int getTypeSynapse(int port);
 
     bool checkID(const char* name);
 
+    // Get the version of the output image: it changes when the output image changes
+    virtual unsigned long getOutputVersion();
+    // Indicate that the output image has changed
+    void newOutputVersion();
+
     // virtual functions //
     // Allocate values
     virtual bool allocateValues();
@@ -95,6 +140,9 @@ public:
     // belongs to any derived class (such as SpikingOutput), it returns false.
     // Therefore this method is used to distingish objects from base class from those from a derived class.
     virtual bool isDummy();
+    // This method returns true if the module output only depends on its current input (the module has
+    // no temporal state). The update of these modules can be skipped when their inputs have not changed.
+    virtual bool isStateless();
 };
 
 #endif // MODULE_H
@@ -5,16 +5,19 @@ whiteNoise::whiteNoise(double mean, double contrast1, double contrast2, double p
     switchTime = switchT;
     GaussianPeriod = period;
 
-    distribution1 = *(new normal_distribution<double>(mean,contrast1*mean));
-    distribution2 = *(new normal_distribution<double>(mean,contrast2*mean));
+    this->mean = mean;
+    sigma1 = contrast1*mean;
+    sigma2 = contrast2*mean;
+    trial = 0;
+    batchSize = 1;
+    streamsInitialized = false;
 
-    output = new CImg <double>(Y,X,1,3);
+    checkerSize = 0;
+    binary = false;
+    frameCount = 0;
+    frameVersion = 0;
 
-    cimg_forXY(*output,x,y) {
-        (*output)(x,y,0,0) = 1.0,
-        (*output)(x,y,0,1) = 1.0,
-        (*output)(x,y,0,2) = 1.0;
-    }
+    output = new CImg <double>(Y,X,1,1,1.0);
 
 }
 
@@ -29,34 +32,115 @@ whiteNoise::~whiteNoise(void){
 //------------------------------------------------------------------------------//
 
 void whiteNoise::initializeDist(unsigned seed){
-    generator1 = *(new default_random_engine(seed));
-    generator2 = *(new default_random_engine(seed));
+    trial = seed;
+    streamsInitialized = false;
+}
 
+bool whiteNoise::setCheckerSize(int size){
+    bool ret_correct;
+    if (size>=0) {
+        checkerSize = size;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
 }
 
-//------------------------------------------------------------------------------//
+bool whiteNoise::setBinary(bool b){
+    binary = b;
+    return(true);
+}
 
+bool whiteNoise::setBatchSize(int b){
+    bool ret_correct;
+    if (b>0) {
+        batchSize = b;
+        output->assign(output->width(), output->height(), batchSize, 1, 1.0);
+        streamsInitialized = false;
+        ret_correct=true;
+    } else
+        ret_correct=false;
+    return(ret_correct);
+}
 
-CImg<double>* whiteNoise::update(double t){
+//------------------------------------------------------------------------------//
 
-    // draw new value from Gaussian distribution
-    if((int)t%(int)GaussianPeriod == 0){
+void whiteNoise::drawFullField(double t, int b){
+    double value = 0;
 
-        double value = 0;
+    if(binary){
         if(t < switchTime)
-            value = distribution1(generator1);
+            value = (stream1[b].uniform() < 0.5)? mean - sigma1 : mean + sigma1;
         else
-            value = distribution2(generator2);
+            value = (stream2[b].uniform() < 0.5)? mean - sigma2 : mean + sigma2;
+    }else{
+        if(t < switchTime)
+            value = stream1[b].normal(mean, sigma1);
+        else
+            value = stream2[b].normal(mean, sigma2);
+    }
 
-        if(value<0.0)
-            value = 0.0;
+    if(value<0.0)
+        value = 0.0;
 
-        cimg_forXY(*output,x,y) {
-            (*output)(x,y,0,0) = value*255,
-            (*output)(x,y,0,1) = value*255,
-            (*output)(x,y,0,2) = value*255;
+    output->get_shared_slice(b).fill(value*255);
+}
+
+// Each frame is drawn from its own substream (substreams 0 and 1 are used by the
+// full-field noise), so the values only depend on the seed, the trial and the frame
+void whiteNoise::drawCheckerboard(double t, int b, uint64_t sub){
+    int width = output->width(), height = output->height();
+    int blocksX = (width + checkerSize - 1)/checkerSize;
+    int blocksY = (height + checkerSize - 1)/checkerSize;
+    double sigma = (t < switchTime)? sigma1 : sigma2;
+
+    blockValues.resize((size_t)blocksX*blocksY);
+    if(binary){
+        CounterRNG::fillUniform(streamKey[b], sub, 0, &blockValues[0], blockValues.size());
+        for(size_t k=0;k<blockValues.size();k++)
+            blockValues[k] = (blockValues[k] < 0.5)? mean - sigma : mean + sigma;
+    }else
+        CounterRNG::fillNormal(streamKey[b], sub, 0, mean, sigma, &blockValues[0], blockValues.size());
+
+    // Expand the blocks into the output image (multithreaded across rows)
+    double *out = output->data(0,0,b);
+    #pragma omp parallel for if(width*height >= 16384)
+    for(int y=0;y<height;y++){
+        const double *row_blocks = &blockValues[(size_t)(y/checkerSize)*blocksX];
+        double *out_row = out + (size_t)y*width;
+        for(int x=0;x<width;x++){
+            double value = row_blocks[x/checkerSize];
+            out_row[x] = (value<0.0)? 0.0 : value*255;
+        }
+    }
+}
+
+CImg<double>* whiteNoise::update(double t){
+
+    // draw new value from Gaussian distribution
+    if((int)t%(int)GaussianPeriod == 0){
+
+        if(!streamsInitialized){
+            streamKey.resize(batchSize);
+            stream1.resize(batchSize);
+            stream2.resize(batchSize);
+            for(int b=0;b<batchSize;b++){
+                streamKey[b] = CounterRNG::streamKey("whiteNoise", (uint64_t)trial*batchSize + b);
+                stream1[b].seed(streamKey[b], 0);
+                stream2[b].seed(streamKey[b], 1);
+            }
+            frameCount = 0;
+            streamsInitialized = true;
         }
 
+        uint64_t sub = 2 + frameCount++;
+        for(int b=0;b<batchSize;b++){
+            if(checkerSize > 0)
+                drawCheckerboard(t, b, sub);
+            else
+                drawFullField(t, b);
+        }
+        frameVersion++;
     }
 
     return output;
@@ -4,18 +4,28 @@
 /* BeginDocumentation
  * Name: whiteNoise
  *
- * Description: White Noise generator.
+ * Description: White Noise generator. By default the noise is a full-field flicker: a
+ * single value drawn from a normal distribution (mean, contrast*mean) every period.
+ * When a checker size is set, the noise is spatiotemporal: an independent value is drawn
+ * for each block of checkerSize x checkerSize pixels (checkerSize = 1 for per-pixel noise).
+ * The values can be Gaussian or binary (mean*(1-contrast) or mean*(1+contrast) with equal
+ * probability). The values of each frame are generated in bulk from a counter-based random
+ * stream (multithreaded and reproducible from the seed, see CounterRNG).
+ * The output image has a single channel (luminance).
+ * In batch mode (see Retina::setBatchSize()) the output has one slice per stimulus. The slice b
+ * of trial t is drawn from the streams of the index t*batchSize+b, so every stimulus of every
+ * trial is independent (with a batch size of 1 the noise of each trial does not change).
  *
  * Author: Pablo Martinez Cañada. University of Granada. CITIC-UGR. Spain.
  * <pablomc@ugr.es>
  *
- * SeeAlso: GratingGenerator, fixationalMovGrating, impulse
+ * SeeAlso: GratingGenerator, fixationalMovGrating, impulse, CounterRNG
  */
 
 #include "../CImg-1.6.0_rolling141127/CImg.h"
 
-#include <random>
-#include <chrono>
+#include <vector>
+#include "CounterRNG.h"
 
 using namespace cimg_library;
 using namespace std;
@@ -23,11 +33,25 @@ using namespace std;
 class whiteNoise{
 private:
 
-    // Normal distributions
-    normal_distribution<double> distribution1;
-    default_random_engine generator1;
-    normal_distribution<double> distribution2;
-    default_random_engine generator2;
+    // Normal distributions (mean and standard deviation before and after switchTime)
+    double mean;
+    double sigma1,sigma2;
+
+    // Random streams of the trial of each stimulus of the batch (keys are derived when the
+    // first value is drawn so that the seed can be set anywhere in the retina script)
+    vector<RandomStream> stream1;
+    vector<RandomStream> stream2;
+    vector<uint64_t> streamKey;
+    unsigned trial;
+    int batchSize;
+    bool streamsInitialized;
+
+    // Spatiotemporal noise: size of the checker blocks in pixels (0 for full-field noise),
+    // binary or Gaussian values and number of frames drawn
+    int checkerSize;
+    bool binary;
+    uint64_t frameCount;
+    vector<double> blockValues;
 
     // time to switch
     double switchTime;
@@ -35,8 +59,13 @@ private:
     // new value
     double GaussianPeriod;
 
-    // Output image
+    // Output image and its version (it changes when a new value or frame is drawn)
     CImg <double> *output;
+    unsigned long frameVersion;
+
+    // draw a new full-field value or a new spatiotemporal frame of a stimulus
+    void drawFullField(double t, int b);
+    void drawCheckerboard(double t, int b, uint64_t sub);
 
 public:
     // Constructor, copy, destructor.
@@ -48,11 +77,21 @@ public:
     // update
     CImg<double>* update(double t);
 
-    // initialize distributions
+    // initialize distributions for a trial
     void initializeDist(unsigned seed);
 
+    // Spatiotemporal noise parameters
+    bool setCheckerSize(int size);
+    bool setBinary(bool b);
+
+    // Number of stimuli (slices of the output)
+    bool setBatchSize(int b);
+
     // get time to switch
     double getSwitchTime(){return switchTime;}
+
+    // version of the output image
+    unsigned long getFrameVersion(){return frameVersion;}
 };
 
 #endif // WHITENOISE_H